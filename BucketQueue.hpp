@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DTRANS_BUCKET_QUEUE_HPP
+#define DTRANS_BUCKET_QUEUE_HPP
+
+#include <vector>
+#include <map>
+#include <math.h>
+#include <stddef.h>
+
+
+namespace dtrans {
+
+
+  /**
+     Untidy (Dial-style) priority queue of grid cell indices. Keys are
+     mapped to buckets of a fixed width, and a circular array of
+     buckets covers a window of keys starting at the lowest non-empty
+     bucket. Keys beyond the window wait in overflow buckets, sorted
+     by bucket number, until the window gets there. Each element
+     migrates into the window once, together with the rest of its
+     bucket. Inserting, removing and popping are O(1) as long as keys
+     grow monotonically by less than the window size, which is the
+     case for fast marching, and O(log n) in the number of overflow
+     buckets otherwise.
+
+     The price is that pop() returns any element of the lowest
+     non-empty bucket, not necessarily the one with the smallest
+     key. The error on the order is thus bounded by the bucket
+     width. Within a bucket, elements come out first in, first out,
+     which on a propagation front tends to be close to the order of
+     their keys. The interface mirrors DaryHeap so that
+     DistanceTransform can use either.
+  */
+  class BucketQueue
+  {
+  public:
+    static size_t const npos = static_cast<size_t>(-1);
+
+    struct entry_s {
+      double key;
+      size_t index;
+    };
+
+    /** Create an unusable queue, call reset() before using it. */
+    BucketQueue()
+      : m_width(1),
+	m_cursor(0),
+	m_size(0),
+	m_head(0),
+	m_noverflow(0)
+    {
+    }
+
+    /** (Re)initialize the queue, dropping all elements. */
+    void reset(/** number of cells that can ever be queued */
+	       size_t ncells,
+	       /** key range covered by one bucket, must be positive */
+	       double width,
+	       /** number of buckets in the circular window */
+	       size_t nbuckets)
+    {
+      m_width = width;
+      m_cursor = 0;
+      m_size = 0;
+      m_head = 0;
+      m_bucket.clear();
+      m_bucket.resize(nbuckets);
+      m_overflow.clear();
+      m_noverflow = 0;
+      m_where.assign(ncells, static_cast<size_t>(npos));
+      m_offset.assign(ncells, 0);
+    }
+
+    inline double width() const { return m_width; }
+    inline size_t nBuckets() const { return m_bucket.size(); }
+    inline bool empty() const { return 0 == m_size; }
+    inline size_t size() const { return m_size; }
+    inline bool contains(size_t index) const { return npos != m_where[index]; }
+
+    /** \note Does not check for an empty queue. */
+    inline double topKey() const { return m_bucket[m_cursor % m_bucket.size()][m_head].key; }
+
+    /** \note Does not check for an empty queue. */
+    inline size_t topIndex() const { return m_bucket[m_cursor % m_bucket.size()][m_head].index; }
+
+    /** Insert a cell, or move it to the bucket of its new key. */
+    inline void set(size_t index, double key)
+    {
+      if (npos != m_where[index]) {
+	detach(index);
+	--m_size;
+      }
+      size_t const bb(bucketOf(key));
+      if (0 == m_size) {
+	m_cursor = bb;
+      }
+      else if (bb < m_cursor) {
+	lowerCursor(bb);
+      }
+      attach(index, key, bb);
+      ++m_size;
+      settle();
+    }
+
+    /** Remove a cell from the queue.
+
+	\return false if the cell was not on the queue. */
+    inline bool remove(size_t index)
+    {
+      if (npos == m_where[index]) {
+	return false;
+      }
+      detach(index);
+      --m_size;
+      settle();
+      return true;
+    }
+
+    /** Remove the element at the top, which lies in the lowest
+	non-empty bucket.
+
+	\note Does not check for an empty queue.
+
+	\return The index of the cell that used to be on top. */
+    inline size_t pop()
+    {
+      std::vector<entry_s> & list(m_bucket[m_cursor % m_bucket.size()]);
+      size_t const index(list[m_head].index);
+      m_where[index] = npos;
+      if (++m_head == list.size()) {
+	list.clear();
+	m_head = 0;
+      }
+      --m_size;
+      settle();
+      return index;
+    }
+
+    /** Append the indices of all queued cells to the given vector,
+	in no particular order. */
+    void collect(std::vector<size_t> & indices) const
+    {
+      size_t const top(m_cursor % m_bucket.size());
+      for (size_t ib(0); ib < m_bucket.size(); ++ib) {
+	for (size_t ii(ib == top ? m_head : 0); ii < m_bucket[ib].size(); ++ii) {
+	  indices.push_back(m_bucket[ib][ii].index);
+	}
+      }
+      for (overflow_cit io(m_overflow.begin()); io != m_overflow.end(); ++io) {
+	for (size_t ii(0); ii < io->second.size(); ++ii) {
+	  indices.push_back(io->second[ii].index);
+	}
+      }
+    }
+    
+    /** Remove all elements. This is proportional to the number of
+	buckets plus the size of the queue. */
+    inline void clear()
+    {
+      for (size_t ib(0); ib < m_bucket.size(); ++ib) {
+	for (size_t ii(0); ii < m_bucket[ib].size(); ++ii) {
+	  m_where[m_bucket[ib][ii].index] = npos;
+	}
+	m_bucket[ib].clear();
+      }
+      for (overflow_cit io(m_overflow.begin()); io != m_overflow.end(); ++io) {
+	for (size_t ii(0); ii < io->second.size(); ++ii) {
+	  m_where[io->second[ii].index] = npos;
+	}
+      }
+      m_overflow.clear();
+      m_noverflow = 0;
+      m_size = 0;
+      m_head = 0;
+    }
+
+  protected:
+    /** Buckets at or above m_cursor + nBuckets(), by absolute
+	number. Only non-empty buckets are kept. */
+    typedef std::map<size_t, std::vector<entry_s> > overflow_t;
+    typedef overflow_t::const_iterator overflow_cit;
+    
+    double m_width;
+    size_t m_cursor;		/**< absolute number of the lowest bucket in the window */
+    size_t m_size;
+    size_t m_head;		/**< entries at the front of the lowest bucket that pop() has taken */
+    std::vector<std::vector<entry_s> > m_bucket;
+    overflow_t m_overflow;
+    size_t m_noverflow;		/**< number of elements in m_overflow */
+    std::vector<size_t> m_where; /**< absolute bucket number, or npos if not queued */
+    std::vector<size_t> m_offset; /**< position inside the bucket */
+
+    inline size_t bucketOf(double key) const
+    {
+      if (key <= 0) {
+	return 0;
+      }
+      double const bb(floor(key / m_width));
+      if (bb >= static_cast<double>(npos - m_bucket.size())) {
+	return npos - m_bucket.size() - 1;
+      }
+      return static_cast<size_t>(bb);
+    }
+
+    inline bool inWindow(size_t bb) const { return bb < m_cursor + m_bucket.size(); }
+
+    /** \return The list of the given bucket, which gets created if
+	it is in the overflow and does not exist yet. */
+    inline std::vector<entry_s> & listOf(size_t bb)
+    {
+      if (inWindow(bb)) {
+	return m_bucket[bb % m_bucket.size()];
+      }
+      return m_overflow[bb];
+    }
+
+    inline void attach(size_t index, double key, size_t bb)
+    {
+      std::vector<entry_s> & list(listOf(bb));
+      m_where[index] = bb;
+      m_offset[index] = list.size();
+      if ( ! inWindow(bb)) {
+	++m_noverflow;
+      }
+      entry_s ee;
+      ee.key = key;
+      ee.index = index;
+      list.push_back(ee);
+    }
+
+    /** Swap-remove a cell from whichever bucket it is in, dropping
+	overflow buckets that become empty. Does not touch m_size. */
+    inline void detach(size_t index)
+    {
+      size_t const bb(m_where[index]);
+      std::vector<entry_s> & list(listOf(bb));
+      size_t const off(m_offset[index]);
+      if (off + 1 < list.size()) {
+	list[off] = list.back();
+	m_offset[list[off].index] = off;
+      }
+      list.pop_back();
+      m_where[index] = npos;
+      if ((bb == m_cursor) && (list.size() == m_head)) {
+	list.clear();
+	m_head = 0;
+      }
+      if ( ! inWindow(bb)) {
+	--m_noverflow;
+	if (list.empty()) {
+	  m_overflow.erase(bb);
+	}
+      }
+    }
+
+    /** Move the window down to start at the given bucket, pushing
+	buckets that fall off its top into the overflow. */
+    void lowerCursor(size_t bb)
+    {
+      size_t const nb(m_bucket.size());
+      if (m_head > 0) {
+	// drop what pop() has taken, the bucket is no longer the lowest
+	std::vector<entry_s> & list(m_bucket[m_cursor % nb]);
+	list.erase(list.begin(), list.begin() + m_head);
+	for (size_t ii(0); ii < list.size(); ++ii) {
+	  m_offset[list[ii].index] = ii;
+	}
+	m_head = 0;
+      }
+      size_t const shift(m_cursor - bb);
+      size_t const nmove(shift < nb ? shift : nb);
+      for (size_t ii(0); ii < nmove; ++ii) {
+	size_t const top(m_cursor + nb - 1 - ii);
+	std::vector<entry_s> & list(m_bucket[top % nb]);
+	if ( ! list.empty()) {
+	  m_noverflow += list.size();
+	  m_overflow[top].swap(list);
+	}
+      }
+      m_cursor = bb;
+    }
+    
+    /** Move the overflow buckets that have entered the window into
+	their place in it. The offsets stay valid, because a bucket
+	that is in the overflow is empty in the window. */
+    void migrate()
+    {
+      size_t const nb(m_bucket.size());
+      while (( ! m_overflow.empty()) && inWindow(m_overflow.begin()->first)) {
+	overflow_t::iterator const io(m_overflow.begin());
+	m_noverflow -= io->second.size();
+	m_bucket[io->first % nb].swap(io->second);
+	m_overflow.erase(io);
+      }
+    }
+
+    /** Advance the window to the lowest non-empty bucket, refilling
+	it from the overflow as the window moves up. */
+    void settle()
+    {
+      if (0 == m_size) {
+	return;
+      }
+      size_t const nb(m_bucket.size());
+      if (m_size == m_noverflow) {
+	// window is empty: jump to the lowest overflow bucket
+	m_cursor = m_overflow.begin()->first;
+	migrate();
+      }
+      while (m_bucket[m_cursor % nb].empty()) {
+	++m_cursor;
+	migrate();
+      }
+    }
+  };
+
+}
+
+#endif // DTRANS_BUCKET_QUEUE_HPP
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DTRANS_CELL_LAYOUT_HPP
+#define DTRANS_CELL_LAYOUT_HPP
+
+#include <stddef.h>
+
+
+namespace dtrans {
+  
+  
+  /**
+     One per-cell quantity of BasicDistanceTransform, e.g. the
+     distance or the queue key, seen as an array of Scalars spaced
+     Stride apart. With Stride=1 this is a plain array, with a larger
+     Stride it is one member of an array of records. The stride is a
+     template parameter, so indexing costs the same as for a plain
+     array either way.
+     
+     This does not own the memory, it merely points into it, and
+     copying a field copies the pointer.
+  */
+  template<typename Scalar, size_t Stride>
+  class CellField
+  {
+  public:
+    CellField() : m_base(0) {}
+    explicit CellField(Scalar * base) : m_base(base) {}
+    
+    /** \note Does not check the index. */
+    inline Scalar & operator [] (size_t index) const { return m_base[index * Stride]; }
+    
+    /** Set the first count cells to the given value. */
+    inline void fill(size_t count, Scalar value) const
+    {
+      for (size_t ii(0); ii < count; ++ii) {
+	m_base[ii * Stride] = value;
+      }
+    }
+    
+  private:
+    Scalar * m_base;
+  };
+  
+  
+  /**
+     Storage policy for BasicDistanceTransform: one array per
+     quantity (struct of arrays). The distances and the queue keys
+     are stored in two consecutive arrays, and the LSM radius and its
+     square are read straight from the SpeedMap. This is the layout
+     of DistanceTransform.
+  */
+  struct SplitCells {
+    static bool const packed = false;
+    static size_t const stride = 1; /**< scalars between the fields of neighboring cells */
+    static size_t const nfields = 2; /**< scalars per cell in the transform's storage */
+  };
+  
+  
+  /**
+     Storage policy for BasicDistanceTransform: one record of
+     {value, radius, key} per cell (array of structs). An update()
+     reads all three for the same cell, so they come in with a single
+     cache line instead of three or four. The square of the radius is
+     computed on the fly instead of being looked up.
+     
+     The radius in the records is a copy of the one in the SpeedMap,
+     which is still kept up to date so that speed maps can be shared
+     with other transforms of either layout. In exchange, the map
+     leaves out the squares of the radii, so both layouts store four
+     scalars per cell: value, key, and the radius in the map plus its
+     square for SplitCells, or the record and the map radius here.
+  */
+  struct PackedCells {
+    static bool const packed = true;
+    static size_t const stride = 3; /**< scalars between the fields of neighboring cells */
+    static size_t const nfields = 3; /**< scalars per cell in the transform's storage */
+  };
+  
+}
+
+#endif // DTRANS_CELL_LAYOUT_HPP
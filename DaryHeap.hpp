@@ -0,0 +1,284 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DTRANS_DARY_HEAP_HPP
+#define DTRANS_DARY_HEAP_HPP
+
+#include <functional>
+#include <vector>
+#include <stddef.h>
+
+
+namespace dtrans {
+
+
+  /**
+     D-ary heap of grid cell indices, ordered by a key of type
+     double. The element for which Before(key, other) holds against
+     all others is on top, so the default std::less<double> gives a
+     min-heap and std::greater<double> a max-heap. The comparison is
+     a template parameter, so it gets inlined instead of going through
+     a function pointer.
+
+     Each cell can be on the heap at most once, and the heap keeps
+     track of the slot in which each cell currently sits. That way,
+     changing the key of a queued cell or removing it takes O(log n)
+     instead of a search through the heap. Keys and indices are
+     stored next to each other so that sifting elements up and down
+     touches a single array.
+
+     A higher arity makes the tree shallower, so sifting up (which is
+     what decreasing a key does) visits fewer slots, and the children
+     of a slot are adjacent in memory when sifting down. With Arity=2
+     this is a plain binary heap, see IndexedHeap.
+
+     The position map is sized for a fixed number of cells at
+     construction time, and it never allocates after that except
+     when the heap array itself grows.
+  */
+  template<size_t Arity = 4, typename Before = std::less<double> >
+  class DaryHeap
+  {
+  public:
+    /** Marker for "this cell is not on the heap". */
+    static size_t const npos = static_cast<size_t>(-1);
+
+    struct entry_s {
+      double key;
+      size_t index;
+    };
+
+    explicit DaryHeap(/** number of cells that can ever be queued,
+			  valid indices are 0..ncells-1 */
+		      size_t ncells)
+      : m_pos(ncells, static_cast<size_t>(npos))
+    {
+      // a unary "tree" would be a list and break the index arithmetic
+      (void) sizeof(char[(Arity >= 2) ? 1 : -1]);
+    }
+
+    inline bool empty() const { return m_entry.empty(); }
+    inline size_t size() const { return m_entry.size(); }
+
+    /** \return true if the given cell is currently on the heap. */
+    inline bool contains(size_t index) const { return npos != m_pos[index]; }
+
+    /** \note Does not check for an empty heap. */
+    inline double topKey() const { return m_entry[0].key; }
+
+    /** \note Does not check for an empty heap. */
+    inline size_t topIndex() const { return m_entry[0].index; }
+
+    /** Direct access to the (unordered) heap array, e.g. for dumping
+	or for statistics. */
+    inline entry_s const & at(size_t slot) const { return m_entry[slot]; }
+
+    /** Insert a cell if it is not yet queued, otherwise change its
+	key and restore the heap property in whichever direction is
+	needed. */
+    inline void set(size_t index, double key)
+    {
+      size_t const slot(m_pos[index]);
+      if (npos == slot) {
+	m_entry.push_back(entry_s());
+	siftUp(m_entry.size() - 1, key, index);
+      }
+      else if (m_before(key, m_entry[slot].key)) {
+	siftUp(slot, key, index);
+      }
+      else {
+	siftDown(slot, key, index);
+      }
+    }
+
+    /** Add a cell without restoring the heap property. This is for
+	filling the heap in bulk: call heapify() once all cells have
+	been appended, and do not use any other method in between.
+	
+	\note Does not check whether the cell is already on the heap. */
+    inline void append(size_t index, double key)
+    {
+      m_pos[index] = m_entry.size();
+      entry_s ee;
+      ee.key = key;
+      ee.index = index;
+      m_entry.push_back(ee);
+    }
+    
+    /** Restore the heap property after append(), bottom-up (Floyd's
+	method). This is O(n) instead of the O(n log n) of inserting
+	all elements one by one with set(). */
+    inline void heapify()
+    {
+      if (m_entry.size() < 2) {
+	return;
+      }
+      size_t slot((m_entry.size() - 2) / Arity + 1);
+      while (slot > 0) {
+	--slot;
+	entry_s const ee(m_entry[slot]);
+	siftDown(slot, ee.key, ee.index);
+      }
+    }
+    
+    /** Restore the heap property after append()ing to a heap that
+	was valid up to the given slot. A few new elements get sifted
+	up one by one, which is much cheaper than heapify() when the
+	heap is large, e.g. when it is filled in many small batches.
+	Only when the batch is large compared to the heap does this
+	fall back to heapify(). */
+    inline void heapifyTail(size_t first)
+    {
+      size_t const nn(m_entry.size());
+      if (first >= nn) {
+	return;
+      }
+      size_t depth(1);
+      for (size_t ss(nn); ss > 1; ss /= Arity) {
+	++depth;
+      }
+      if ((nn - first) * depth >= nn) {
+	heapify();
+	return;
+      }
+      for (size_t slot(first); slot < nn; ++slot) {
+	entry_s const ee(m_entry[slot]);
+	siftUp(slot, ee.key, ee.index);
+      }
+    }
+    
+    /** Remove a cell from the heap.
+
+	\return false if the cell was not on the heap. */
+    inline bool remove(size_t index)
+    {
+      size_t const slot(m_pos[index]);
+      if (npos == slot) {
+	return false;
+      }
+      m_pos[index] = npos;
+      entry_s const last(m_entry.back());
+      m_entry.pop_back();
+      if (slot < m_entry.size()) {
+	if (m_before(last.key, m_entry[slot].key)) {
+	  siftUp(slot, last.key, last.index);
+	}
+	else {
+	  siftDown(slot, last.key, last.index);
+	}
+      }
+      return true;
+    }
+
+    /** Remove the top element.
+
+	\note Does not check for an empty heap.
+
+	\return The index of the cell that used to be on top. */
+    inline size_t pop()
+    {
+      size_t const index(m_entry[0].index);
+      m_pos[index] = npos;
+      entry_s const last(m_entry.back());
+      m_entry.pop_back();
+      if ( ! m_entry.empty()) {
+	siftDown(0, last.key, last.index);
+      }
+      return index;
+    }
+
+    /** Remove all elements. This is proportional to the size of the
+	heap, not to the number of cells. */
+    inline void clear()
+    {
+      for (size_t ii(0); ii < m_entry.size(); ++ii) {
+	m_pos[m_entry[ii].index] = npos;
+      }
+      m_entry.clear();
+    }
+
+  protected:
+    std::vector<entry_s> m_entry;
+    std::vector<size_t> m_pos;	/**< cell index to heap slot, or npos */
+    Before m_before;
+
+    /** Move a hole at the given slot towards the root until the given
+	key fits, then store the element there. */
+    inline void siftUp(size_t slot, double key, size_t index)
+    {
+      while (slot > 0) {
+	size_t const parent((slot - 1) / Arity);
+	if ( ! m_before(key, m_entry[parent].key)) {
+	  break;
+	}
+	m_entry[slot] = m_entry[parent];
+	m_pos[m_entry[slot].index] = slot;
+	slot = parent;
+      }
+      m_entry[slot].key = key;
+      m_entry[slot].index = index;
+      m_pos[index] = slot;
+    }
+
+    /** Move a hole at the given slot towards the leaves until the
+	given key fits, then store the element there. Among children
+	with equal keys, the first one wins. */
+    inline void siftDown(size_t slot, double key, size_t index)
+    {
+      size_t const len(m_entry.size());
+      for (;;) {
+	size_t const first(Arity * slot + 1);
+	if (first >= len) {
+	  break;
+	}
+	size_t const end((len - first > Arity) ? first + Arity : len);
+	size_t child(first);
+	for (size_t cc(first + 1); cc < end; ++cc) {
+	  if (m_before(m_entry[cc].key, m_entry[child].key)) {
+	    child = cc;
+	  }
+	}
+	if ( ! m_before(m_entry[child].key, key)) {
+	  break;
+	}
+	m_entry[slot] = m_entry[child];
+	m_pos[m_entry[slot].index] = slot;
+	slot = child;
+      }
+      m_entry[slot].key = key;
+      m_entry[slot].index = index;
+      m_pos[index] = slot;
+    }
+  };
+
+}
+
+#endif // DTRANS_DARY_HEAP_HPP
@@ -31,7 +31,10 @@
 
 #include "DistanceTransform.hpp"
 #include <limits>
+#include <algorithm>
 #include <math.h>
+#include <pthread.h>
+#include <time.h>
 
 // cheap error messages, should use something else...
 #include <iostream>
@@ -39,282 +42,1793 @@
 
 namespace dtrans {
   
-  double const DistanceTransform::infinity(std::numeric_limits<double>::max());
-  double const DistanceTransform::epsilon(1e-6);
+  template<typename Scalar, typename Cells>
+  Scalar const BasicDistanceTransform<Scalar, Cells>::infinity(std::numeric_limits<Scalar>::max());
   
+  // 1e-6 for double. Single precision only has about seven digits,
+  // so the square of the largest radius has to stay well below 1e7
+  // in units of the smallest one.
+  template<typename Scalar, typename Cells>
+  Scalar const BasicDistanceTransform<Scalar, Cells>::
+  epsilon(std::numeric_limits<Scalar>::digits < std::numeric_limits<double>::digits ? 1e-3 : 1e-6);
   
-  DistanceTransform::
-  DistanceTransform(size_t dimx, size_t dimy, double scale)
-    : m_dimx(dimx),
+  template<typename Scalar, typename Cells>
+  size_t const BasicDistanceTransform<Scalar, Cells>::nolabel(static_cast<size_t>(-1));
+  
+  
+  template<typename Scalar, typename Cells>
+  BasicDistanceTransform<Scalar, Cells>::
+  BasicDistanceTransform(size_t dimx, size_t dimy, double scale)
+    : m_grid(dimx, dimy),
+      m_slots(dimx + 2, dimy + 2),
+      m_dimx(dimx),
       m_dimy(dimy),
-      m_ncells(dimx * dimy),
-      m_toprow(m_ncells - dimx),
-      m_rightcol(dimx - 1),
+      m_pitch(m_slots.stride(1)),
+      m_nslots(m_slots.nCells()),
       m_scale(scale),
-      m_value(m_ncells, infinity),
-      m_lsm_radius(m_ncells, scale),
-      m_lsm_r2(m_ncells, pow(scale, 2.0)),
-      m_key(m_ncells, -1.0),
-      m_gx(m_ncells, 0.0),
-      m_gy(m_ncells, 0.0),
-      m_gn(m_ncells, -1)
+      m_store(m_nslots * Cells::nfields),
+      m_speed(0),
+      m_queue(m_nslots),
+      m_bucketed(false),
+      m_second_order(false),
+      m_gn_used(false),
+      m_goal_weight(0),
+      m_touched_all(false)
+  {
+    bindCells();
+    m_value.fill(m_nslots, infinity);
+    m_key.fill(m_nslots, -1.0);
+    initBorder();
+    attachSpeed(new speed_map_t(dimx, dimy, scale, ! Cells::packed));
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  BasicDistanceTransform<Scalar, Cells>::
+  BasicDistanceTransform(speed_map_t const * speed)
+    : m_grid(speed->dimX(), speed->dimY()),
+      m_slots(speed->dimX() + 2, speed->dimY() + 2),
+      m_dimx(speed->dimX()),
+      m_dimy(speed->dimY()),
+      m_pitch(m_slots.stride(1)),
+      m_nslots(m_slots.nCells()),
+      m_scale(speed->scale()),
+      m_store(m_nslots * Cells::nfields),
+      m_speed(0),
+      m_queue(m_nslots),
+      m_bucketed(false),
+      m_second_order(false),
+      m_gn_used(false),
+      m_goal_weight(0),
+      m_touched_all(false)
+  {
+    bindCells();
+    m_value.fill(m_nslots, infinity);
+    m_key.fill(m_nslots, -1.0);
+    initBorder();
+    // The map only gets written after ownSpeed() has made sure that
+    // nobody else uses it, so dropping the const is safe.
+    attachSpeed(const_cast<speed_map_t*>(speed));
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  BasicDistanceTransform<Scalar, Cells>::
+  BasicDistanceTransform(BasicDistanceTransform const & orig)
+    : m_grid(orig.m_grid),
+      m_slots(orig.m_slots),
+      m_dimx(orig.m_dimx),
+      m_dimy(orig.m_dimy),
+      m_pitch(orig.m_pitch),
+      m_nslots(orig.m_nslots),
+      m_scale(orig.m_scale),
+      m_store(orig.m_store),
+      m_speed(0),
+      m_label(orig.m_label),
+      m_queue(orig.m_queue),
+      m_buckets(orig.m_buckets),
+      m_bucketed(orig.m_bucketed),
+      m_second_order(orig.m_second_order),
+      m_gx(orig.m_gx),
+      m_gy(orig.m_gy),
+      m_gn(orig.m_gn),
+      m_gn_used(orig.m_gn_used),
+      m_goal_x(orig.m_goal_x),
+      m_goal_y(orig.m_goal_y),
+      m_goal_weight(orig.m_goal_weight),
+      m_deferred(orig.m_deferred),
+      m_touched(orig.m_touched),
+      m_touched_all(orig.m_touched_all)
+  {
+    bindCells();
+    attachSpeed(orig.m_speed);
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  BasicDistanceTransform<Scalar, Cells>::
+  ~BasicDistanceTransform()
+  {
+    if (m_speed->unref()) {
+      delete m_speed;
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  initBorder()
+  {
+    size_t const top(m_slots.lastSlab());
+    for (size_t ix(0); ix < m_pitch; ++ix) {
+      m_value[ix] = -infinity;
+      m_value[top + ix] = -infinity;
+    }
+    for (size_t ii(m_pitch); ii < top; ii += m_pitch) {
+      m_value[ii] = -infinity;
+      m_value[ii + m_pitch - 1] = -infinity;
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  bindCells()
+  {
+    if (Cells::packed) {	// records of value, radius, key
+      m_value = field_t(&m_store[0]);
+      m_lsm_radius = field_t(&m_store[1]);
+      m_key = field_t(&m_store[2]);
+    }
+    else {			// all values, then all keys
+      m_value = field_t(&m_store[0]);
+      m_key = field_t(&m_store[m_nslots]);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  attachSpeed(speed_map_t * speed)
+  {
+    if (( ! Cells::packed) && speed->m_r2.empty()) {
+      // The map comes from a packed transform, which does not store
+      // the squares. Filling them in would write to a map that
+      // others may be reading, so work on a copy that has them.
+      speed = new speed_map_t(*speed);
+    }
+    if (m_speed && m_speed->unref()) {
+      delete m_speed;
+    }
+    m_speed = speed;
+    m_speed->ref();
+    if (Cells::packed) {
+      m_lsm_r2 = 0;
+      for (size_t ii(0); ii < m_nslots; ++ii) {
+	m_lsm_radius[ii] = m_speed->m_radius[ii];
+      }
+    }
+    else {
+      m_lsm_r2 = &m_speed->m_r2[0];
+      m_lsm_radius = field_t(&m_speed->m_radius[0]);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  ownSpeed()
+  {
+    if (m_speed->refCount() > 1) {
+      attachSpeed(new speed_map_t(*m_speed, ! Cells::packed));
+    }
+    else if (Cells::packed && ! m_speed->m_r2.empty()) {
+      // left over from split transforms that used to share the map
+      std::vector<Scalar>().swap(m_speed->m_r2);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setDist(size_t ix, size_t iy, double dist)
+  {
+    if ((dist < 0) || ( ! isValid(ix, iy))) {
+      return false;
+    }
+    
+    size_t const cell(slot(ix, iy));
+    
+    if (m_value[cell] >= infinity) {
+      touch(cell);
+    }
+    m_value[cell] = -narrow(dist); // <=0 means "fixed"
+    if ( ! m_label.empty()) {
+      m_label[cell] = nolabel;
+    }
+    requeue(cell);
+    
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setDist(size_t ix, size_t iy, double dist, size_t label)
+  {
+    if ( ! setDist(ix, iy, dist)) {
+      return false;
+    }
+    if (m_label.empty()) {
+      m_label.assign(m_nslots, nolabel);
+    }
+    m_label[slot(ix, iy)] = label;
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setSpeed(size_t ix, size_t iy, double speed)
+  {
+    if ((speed < 0) || (speed > 1) || ( ! isValid(ix, iy))) {
+      return false;
+    }
+    
+    size_t const cell(slot(ix, iy));
+    ownSpeed();
+    
+    if (speed < epsilon) {	// obstacle
+      storeRadius(cell, infinity, infinity);
+    }
+    else {
+      Scalar const radius(m_scale / speed);
+      storeRadius(cell, radius, pow(radius, 2));
+    }
+    
+    return true;
+  }
+  
+  
+  /** Compute the end of the row range of a bulk setter.
+      
+      \return False if the first row lies outside the grid. */
+  static inline bool
+  clip_rows(size_t dimy, size_t y0, size_t ny, size_t & y1)
+  {
+    if (y0 >= dimy) {
+      return false;
+    }
+    y1 = (ny > dimy - y0) ? dimy : y0 + ny;
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setSpeedBuffer(float const * speed, ptrdiff_t stride, size_t y0, size_t ny)
+  {
+    size_t y1;
+    if ( ! clip_rows(m_dimy, y0, ny, y1)) {
+      return false;
+    }
+    
+    ownSpeed();
+    bool ok(true);
+    for (size_t iy(y0); iy < y1; ++iy) {
+      float const * row(speed + static_cast<ptrdiff_t>(iy - y0) * stride);
+      size_t const offset(slot(0, iy));
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	double const ss(row[ix]);
+	if ( ! ((ss >= 0) && (ss <= 1))) { // this also catches NaN
+	  ok = false;
+	}
+	else if (ss < epsilon) {
+	  storeRadius(offset + ix, infinity, infinity);
+	}
+	else {
+	  Scalar const radius(m_scale / ss);
+	  storeRadius(offset + ix, radius, radius * radius);
+	}
+      }
+    }
+    return ok;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setSpeedBuffer(unsigned char const * data, ptrdiff_t stride, double const * lut,
+		 size_t y0, size_t ny)
+  {
+    size_t y1;
+    if ( ! clip_rows(m_dimy, y0, ny, y1)) {
+      return false;
+    }
+    
+    Scalar radius[256];
+    Scalar r2[256];
+    for (size_t ii(0); ii < 256; ++ii) {
+      if ( ! ((lut[ii] >= 0) && (lut[ii] <= 1))) {
+	return false;
+      }
+      if (lut[ii] < epsilon) {
+	radius[ii] = infinity;
+	r2[ii] = infinity;
+      }
+      else {
+	radius[ii] = m_scale / lut[ii];
+	r2[ii] = pow(radius[ii], 2);
+      }
+    }
+    
+    ownSpeed();
+    for (size_t iy(y0); iy < y1; ++iy) {
+      unsigned char const * row(data + static_cast<ptrdiff_t>(iy - y0) * stride);
+      size_t const offset(slot(0, iy));
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	storeRadius(offset + ix, radius[row[ix]], r2[row[ix]]);
+      }
+    }
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  storeSeed(size_t index, Scalar dist, std::vector<size_t> & pending)
+  {
+    if (m_value[index] >= infinity) {
+      touch(index);
+    }
+    m_value[index] = -dist;	// <=0 means "fixed"
+    if ( ! m_label.empty()) {
+      m_label[index] = nolabel;
+    }
+    if (m_bucketed) {
+      requeue(index);
+      return;
+    }
+    if (m_key[index] >= 0) {
+      pending.push_back(index);
+    }
+    else {
+      m_queue.append(index, dist);
+    }
+    m_key[index] = dist;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  finishSeeds(size_t oldsize, std::vector<size_t> const & pending)
+  {
+    if (m_bucketed) {
+      return;
+    }
+    m_queue.heapifyTail(oldsize);
+    for (size_t ii(0); ii < pending.size(); ++ii) {
+      m_queue.set(pending[ii], m_key[pending[ii]]);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setDistBuffer(float const * dist, ptrdiff_t stride, size_t y0, size_t ny)
+  {
+    size_t y1;
+    if ( ! clip_rows(m_dimy, y0, ny, y1)) {
+      return false;
+    }
+    
+    size_t const oldsize(m_queue.size());
+    std::vector<size_t> pending;
+    for (size_t iy(y0); iy < y1; ++iy) {
+      float const * row(dist + static_cast<ptrdiff_t>(iy - y0) * stride);
+      size_t const offset(slot(0, iy));
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	double const dd(row[ix]);
+	if ((dd >= 0) && (dd < infinity)) { // this also skips NaN
+	  storeSeed(offset + ix, dd, pending);
+	}
+      }
+    }
+    finishSeeds(oldsize, pending);
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setDistBuffer(unsigned char const * data, ptrdiff_t stride, double const * lut,
+		size_t y0, size_t ny)
+  {
+    size_t y1;
+    if ( ! clip_rows(m_dimy, y0, ny, y1)) {
+      return false;
+    }
+    
+    size_t const oldsize(m_queue.size());
+    std::vector<size_t> pending;
+    for (size_t iy(y0); iy < y1; ++iy) {
+      unsigned char const * row(data + static_cast<ptrdiff_t>(iy - y0) * stride);
+      size_t const offset(slot(0, iy));
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	double const dd(lut[row[ix]]);
+	if ((dd >= 0) && (dd < infinity)) {
+	  storeSeed(offset + ix, dd, pending);
+	}
+      }
+    }
+    finishSeeds(oldsize, pending);
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  invalidateGradient(size_t index)
   {
+    if ( ! m_gn_used) {
+      return;
+    }
+    m_gn[index] = -1;
+    m_gn[index - m_pitch] = -1;
+    m_gn[index + m_pitch] = -1;
+    m_gn[index - 1] = -1;
+    m_gn[index + 1] = -1;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  collect(size_t nn, Scalar vc, Scalar vother, Scalar vcross,
+	  std::vector<size_t> & region, std::vector<Scalar> & old)
+  {
+    Scalar const vn(m_value[nn]);
+    if ((vn <= vc) || (vn >= infinity) || (vc >= vother)) {
+      return;
+    }
+    if ((vc > vcross) && (m_lsm_radius[nn] <= vc - vcross)) {
+      return;			// secondary, but not used for interpolation
+    }
+    region.push_back(nn);
+    old.push_back(vn);
+    m_value[nn] = infinity;
+  }
+  
+  
+  /** Check whether the stencil of cell n2 reaches over n1 to use the
+      invalidated cell (which had distance vc), where n3 is the cell
+      beyond n2 on the same axis (or npos). */
+  template<typename Scalar>
+  static inline bool
+  uses_second(Scalar vc, Scalar v1, Scalar v2, Scalar v3)
+  {
+    v1 = fabs(v1);
+    return (vc <= v1) && (v1 < v2) && (v2 < std::numeric_limits<Scalar>::max()) && (v1 <= fabs(v3));
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  collect2(size_t cc, size_t ix, size_t iy, Scalar vc,
+	   std::vector<size_t> & region, std::vector<Scalar> & old)
+  {
+    // A region cell in between is at infinity, which fails the test,
+    // but then that cell takes care of its own neighbors. The cell
+    // beyond the one two steps away can be on the border, which
+    // counts as infinity, but no further.
+    size_t const d2(2 * m_pitch);
+    size_t nn[4];
+    size_t count(0);
+    if ((iy > 1) && uses_second(vc, m_value[cc - m_pitch], m_value[cc - d2],
+				m_value[cc - d2 - m_pitch])) {
+      nn[count++] = cc - d2;
+    }
+    if ((iy + 2 < m_dimy) && uses_second(vc, m_value[cc + m_pitch], m_value[cc + d2],
+					 m_value[cc + d2 + m_pitch])) {
+      nn[count++] = cc + d2;
+    }
+    if ((ix > 1) && uses_second(vc, m_value[cc - 1], m_value[cc - 2], m_value[cc - 3])) {
+      nn[count++] = cc - 2;
+    }
+    if ((ix + 2 < m_dimx) && uses_second(vc, m_value[cc + 1], m_value[cc + 2], m_value[cc + 3])) {
+      nn[count++] = cc + 2;
+    }
+    for (size_t ii(0); ii < count; ++ii) {
+      region.push_back(nn[ii]);
+      old.push_back(m_value[nn[ii]]);
+      m_value[nn[ii]] = infinity;
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  raise(size_t index)
+  {
+    Scalar const value(m_value[index]);
+    if ((value <= 0) || (value >= infinity)) {
+      // Seeds do not depend on their speed, obstacles cannot get any
+      // slower, and cells that have not been reached yet will see
+      // the new speed when they are.
+      return;
+    }
+    
+    // Invalidate the cell and everything downwind of it. Cells in
+    // the region are set to infinity right away, which also serves
+    // to mark them as visited, so their old distance has to be kept
+    // around for checking their own downwind neighbors.
+    std::vector<size_t> region(1, index);
+    std::vector<Scalar> old(1, value);
+    m_value[index] = infinity;
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      Scalar const vc(old[ir]);
+      // Border cells are fixed, so they never join the region. That
+      // check has to come first, because the cells beyond them lie
+      // outside the storage.
+      if (m_value[cc - m_pitch] > 0) { // south
+	size_t const nn(cc - m_pitch);
+	collect(nn, vc, fabs(m_value[nn - m_pitch]), ewMin(nn), region, old);
+      }
+      if (m_value[cc + m_pitch] > 0) { // north
+	size_t const nn(cc + m_pitch);
+	collect(nn, vc, fabs(m_value[nn + m_pitch]), ewMin(nn), region, old);
+      }
+      if (m_value[cc - 1] > 0) {	// west
+	collect(cc - 1, vc, fabs(m_value[cc - 2]), nsMin(cc - 1), region, old);
+      }
+      if (m_value[cc + 1] > 0) {	// east
+	collect(cc + 1, vc, fabs(m_value[cc + 2]), nsMin(cc + 1), region, old);
+      }
+      if (m_second_order) {
+	collect2(cc, cc % m_pitch - 1, cc / m_pitch - 1, vc, region, old);
+      }
+    }
+    
+    // Whatever is still valid around the region now propagates back
+    // into it. Queueing the cells along the rim of the region with
+    // the distance they get from their valid neighbors is enough to
+    // get that going. All of the region has to stay at infinity
+    // until the rim has been found, so the new distances (and
+    // labels) are collected first.
+    std::vector<size_t> label;
+    if ( ! m_label.empty()) {
+      label.resize(region.size());
+    }
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      if (m_key[cc] >= 0) {
+	unqueue(cc);
+      }
+      invalidateGradient(cc);
+      if (m_lsm_radius[cc] >= infinity) { // the cell that became an obstacle
+	old[ir] = -infinity;
+      }
+      else {
+	old[ir] = solve(cc);
+      }
+      if ( ! label.empty()) {
+	inheritLabel(cc);
+	label[ir] = (fabs(old[ir]) < infinity) ? m_label[cc] : nolabel;
+      }
+    }
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      m_value[cc] = old[ir];
+      if ( ! label.empty()) {
+	m_label[cc] = label[ir];
+      }
+      if ((old[ir] > 0) && (old[ir] < infinity)) {
+	requeue(cc);
+      }
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  lower(size_t index)
+  {
+    Scalar const value(m_value[index]);
+    if (value >= infinity) {	// not reached yet, nothing to repair
+      return;
+    }
+    if (value <= -infinity) {	// obstacle that has become free space
+      m_value[index] = infinity;
+    }
+    else if (value <= 0) {	// seed, does not depend on its speed
+      return;
+    }
+    
+    Scalar const rhs(solve(index));
+    if (rhs < m_value[index]) {
+      m_value[index] = rhs;
+      inheritLabel(index);
+      requeue(index);
+      invalidateGradient(index);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  double BasicDistanceTransform<Scalar, Cells>::
+  getDist(size_t ix, size_t iy) const
+  {
+    if ( ! isValid(ix, iy)) {
+      return infinity;
+    }
+    return fabs(m_value[slot(ix, iy)]);
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  size_t BasicDistanceTransform<Scalar, Cells>::
+  getLabel(size_t ix, size_t iy) const
+  {
+    if (( ! isValid(ix, iy)) || m_label.empty()) {
+      return nolabel;
+    }
+    return m_label[slot(ix, iy)];
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  compute(double ceiling)
+  {
+    while ( ! queueEmpty()) {
+      if (queueTopKey() > ceiling) {
+	break;
+      }
+      propagate();
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  typename BasicDistanceTransform<Scalar, Cells>::reach_t BasicDistanceTransform<Scalar, Cells>::
+  computeUntil(size_t ix, size_t iy, double heuristic)
+  {
+    if ((ix >= m_dimx) || (iy >= m_dimy)) {
+      return UNREACHED;
+    }
+    return computeUntil(std::vector<size_t>(1, index(ix, iy)), heuristic);
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  typename BasicDistanceTransform<Scalar, Cells>::reach_t BasicDistanceTransform<Scalar, Cells>::
+  computeUntil(std::vector<size_t> const & targets, double heuristic)
+  {
+    if ( ! ((heuristic >= 0) && (heuristic <= 1))) { // also catches NaN
+      return UNREACHED;
+    }
+    bool ok(true);
+    std::vector<size_t> slots;
+    std::vector<size_t> pending;
+    for (size_t ii(0); ii < targets.size(); ++ii) {
+      if (targets[ii] >= m_grid.nCells()) {
+	ok = false;
+	continue;
+      }
+      size_t const tt(slotOf(targets[ii]));
+      if (m_lsm_radius[tt] >= infinity) {
+	ok = false;
+	continue;
+      }
+      slots.push_back(tt);
+      if ((m_key[tt] >= 0) || (fabs(m_value[tt]) >= infinity)) {
+	// a finite distance that is not queued has been expanded
+	pending.push_back(tt);
+      }
+    }
+    std::sort(pending.begin(), pending.end());
+    pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+    
+    if ((heuristic > 0) && ( ! pending.empty())) {
+      m_goal_weight = heuristic;
+      // in storage coordinates, like the ones heuristic() uses
+      for (size_t ii(0); ii < pending.size(); ++ii) {
+	m_goal_x.push_back(pending[ii] % m_pitch);
+	m_goal_y.push_back(pending[ii] / m_pitch);
+      }
+      rekey();
+    }
+    
+    std::vector<bool> reached(pending.size(), false);
+    size_t npending(pending.size());
+    while ((npending > 0) && ( ! queueEmpty())) {
+      size_t const index(pop());
+      expand(index);
+      std::vector<size_t>::const_iterator
+	it(std::lower_bound(pending.begin(), pending.end(), index));
+      if ((pending.end() != it) && (*it == index)
+	  && ( ! reached[it - pending.begin()])) {
+	reached[it - pending.begin()] = true;
+	--npending;
+      }
+    }
+    
+    if ((heuristic > 0) && ( ! pending.empty())) {
+      m_goal_x.clear();
+      m_goal_y.clear();
+      rekey();
+      for (size_t ii(0); ii < m_deferred.size(); ++ii) {
+	update(m_deferred[ii]);
+      }
+      m_deferred.clear();
+    }
+    
+    if (( ! ok) || (npending > 0)) {
+      return UNREACHED;
+    }
+    
+    // With plain keys, an expanded target is final once nothing
+    // below its distance is left in the queue. Targets that were
+    // expanded earlier with a heuristic, or that got lowered again,
+    // need more propagation to get there.
+    reach_t reach(REACHED_FINAL);
+    while ( ! queueEmpty()) {
+      double const top(queueTopKey());
+      size_t ii(0);
+      while ((ii < slots.size()) && (m_key[slots[ii]] < 0) && (m_value[slots[ii]] <= top)) {
+	++ii;
+      }
+      if (slots.size() == ii) {
+	break;
+      }
+      if (heuristic > 0) {
+	reach = REACHED_UPPER_BOUND;
+	break;
+      }
+      expand(pop());
+    }
+    
+    return reach;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  typename BasicDistanceTransform<Scalar, Cells>::progress_s BasicDistanceTransform<Scalar, Cells>::
+  computeFor(size_t max_expansions)
+  {
+    progress_s progress;
+    progress.expansions = 0;
+    while ((progress.expansions < max_expansions) && ( ! queueEmpty())) {
+      expand(pop());
+      ++progress.expansions;
+    }
+    progress.top_key = getTopKey();
+    return progress;
+  }
+  
+  
+  /** Monotonic clock, so that computeForTime() deadlines do not
+      move when the wall clock gets adjusted. */
+  static double now()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  typename BasicDistanceTransform<Scalar, Cells>::progress_s BasicDistanceTransform<Scalar, Cells>::
+  computeForTime(double max_seconds)
+  {
+    // Reading the clock costs about as much as a few expansions, so
+    // only do it once per chunk.
+    static size_t const chunk(64);
+    double const deadline(now() + max_seconds);
+    progress_s progress;
+    progress.expansions = 0;
+    while ( ! queueEmpty()) {
+      if (0 == progress.expansions % chunk) {
+	if (now() >= deadline) {
+	  break;
+	}
+      }
+      expand(pop());
+      ++progress.expansions;
+    }
+    progress.top_key = getTopKey();
+    return progress;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  double BasicDistanceTransform<Scalar, Cells>::
+  heuristic(size_t index) const
+  {
+    double const ix(index % m_pitch);
+    double const iy(index / m_pitch);
+    double best(infinity);
+    for (size_t ii(0); ii < m_goal_x.size(); ++ii) {
+      double const dd(hypot(ix - m_goal_x[ii], iy - m_goal_y[ii]));
+      if (dd < best) {
+	best = dd;
+      }
+    }
+    // speeds are at most one, so no cell is cheaper than m_scale
+    return m_goal_weight * m_scale * best;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  rekey()
+  {
+    std::vector<size_t> queued;
+    if (m_bucketed) {
+      m_buckets.collect(queued);
+      for (size_t ii(0); ii < queued.size(); ++ii) {
+	requeue(queued[ii]);
+      }
+      return;
+    }
+    queued.reserve(m_queue.size());
+    for (size_t ii(0); ii < m_queue.size(); ++ii) {
+      queued.push_back(m_queue.at(ii).index);
+    }
+    m_queue.clear();
+    for (size_t ii(0); ii < queued.size(); ++ii) {
+      m_key[queued[ii]] = keyOf(queued[ii]);
+      m_queue.append(queued[ii], m_key[queued[ii]]);
+    }
+    m_queue.heapify();
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  compute(double ceiling, FILE * dbg_fp, std::string const & dbg_prefix)
+  {
+    std::string prefix(dbg_prefix + "  ");
+    for (size_t ii(0); ! queueEmpty(); ++ii) {
+      fprintf(stdout, "%siteration %zu\n", dbg_prefix.c_str(), ii);
+      if (queueTopKey() > ceiling) {
+	fprintf(stdout, "%stop of queue %g is above ceiling %g\n",
+		dbg_prefix.c_str(), queueTopKey(), ceiling);
+	break;
+      }
+      dump(stdout, prefix.c_str());
+      propagate();
+    }
+    fprintf(stdout, "%sfinal\n", dbg_prefix.c_str());
+    dump(stdout, prefix.c_str());
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  setQueuePolicy(queue_policy_t policy, double bucket_width)
+  {
+    if (BUCKET_QUEUE == policy) {
+      if ((bucket_width <= 0) || (bucket_width > m_scale)) {
+	return false;
+      }
+      // Size the window such that it covers the largest step a
+      // single expansion can make, within reason. Anything beyond
+      // goes to the overflow list.
+      double maxradius(m_scale);
+      for (size_t ii(0); ii < m_nslots; ++ii) {
+	if ((m_lsm_radius[ii] < infinity) && (m_lsm_radius[ii] > maxradius)) {
+	  maxradius = m_lsm_radius[ii];
+	}
+      }
+      double const span(2 * ceil(maxradius / bucket_width) + 2);
+      size_t const nbuckets(span < 64 ? 64 : (span > 65536 ? 65536 : static_cast<size_t>(span)));
+      m_buckets.reset(m_nslots, bucket_width, nbuckets);
+    }
+    
+    bool const bucketed(BUCKET_QUEUE == policy);
+    if (bucketed != m_bucketed) {
+      m_queue.clear();
+      m_buckets.clear();
+      m_bucketed = bucketed;
+      for (size_t ii(0); ii < m_nslots; ++ii) {
+	if (m_key[ii] >= 0) {
+	  if (m_bucketed) {
+	    m_buckets.set(ii, m_key[ii]);
+	  }
+	  else {
+	    m_queue.set(ii, m_key[ii]);
+	  }
+	}
+      }
+    }
+    else if (m_bucketed) {
+      // new bucket width: m_buckets was reset above, so refill it
+      for (size_t ii(0); ii < m_nslots; ++ii) {
+	if (m_key[ii] >= 0) {
+	  m_buckets.set(ii, m_key[ii]);
+	}
+      }
+    }
+    
+    return true;
+  }
+  
+  
+  /** Don't call this unless you are (pretty) sure that the index is
+      on the queue. */
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  unqueue(size_t index)
+  {
+    if ( ! (m_bucketed ? m_buckets.remove(index) : m_queue.remove(index))) {
+      return false;
+    }
+    m_key[index] = -1;
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  requeue(size_t index)
+  {
+    if ((m_key[index] >= 0) && ( ! queueContains(index))) {
+      std::cerr << "bug in requeue? key says queued but queue disagrees\n";
+    }
+    m_key[index] = keyOf(index);
+    if (m_bucketed) {
+      m_buckets.set(index, m_key[index]);
+    }
+    else {
+      m_queue.set(index, m_key[index]);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  Scalar BasicDistanceTransform<Scalar, Cells>::
+  solve(size_t index) const
+  {
+    if (m_second_order) {
+      return solve2(index);
+    }
+    
+    // Find the best propagator along each axis. This is all the
+    // interpolation needs: the primary is the lower of the two, and
+    // the secondary has to lie along the other axis. Border cells
+    // count as infinity.
+    Scalar const ns(nsMin(index));
+    Scalar const ew(ewMin(index));
+    Scalar primary(ns);
+    Scalar secondary(ew);
+    if (secondary < primary) {
+      primary = ew;
+      secondary = ns;
+    }
+    if (primary >= infinity) {
+      return infinity;
+    }
+    
+    // Interpolate if the secondary is closer than m_scale/speed to
+    // the primary, otherwise propagate from the primary alone. An
+    // invalid secondary is at infinity and thus never closer. The
+    // quadratic is solved for the step above the primary, so that
+    // the large distances cancel out before anything is squared,
+    // which is what makes float good enough.
+    Scalar const radius(m_lsm_radius[index]);
+    if (radius > secondary - primary) {
+      Scalar const dd(secondary - primary);
+      return primary + (dd + sqrt(2 * r2(index) - dd * dd)) / 2;
+    }
+    return primary + radius;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  Scalar BasicDistanceTransform<Scalar, Cells>::
+  solve2(size_t index) const
+  {
+    // Same choice of neighbors as solve(), but each axis contributes
+    // a weight and a center, which are the neighbor itself (weight
+    // one) or the second-order extrapolation (weight 9/4). A
+    // neighbor with a finite distance is never on the border, so the
+    // cell beyond it always exists.
+    Scalar ns(infinity);
+    Scalar wns(1);
+    size_t n1(index);
+    if (fabs(m_value[index - m_pitch]) < ns) {
+      n1 = index - m_pitch;
+      ns = fabs(m_value[n1]);
+    }
+    if (fabs(m_value[index + m_pitch]) < ns) {
+      n1 = index + m_pitch;
+      ns = fabs(m_value[n1]);
+    }
+    if (ns < infinity) {
+      wns = upwind2(n1, (n1 < index) ? n1 - m_pitch : n1 + m_pitch, ns);
+    }
+    
+    Scalar ew(infinity);
+    Scalar wew(1);
+    n1 = index;
+    if (fabs(m_value[index - 1]) < ew) {
+      n1 = index - 1;
+      ew = fabs(m_value[n1]);
+    }
+    if (fabs(m_value[index + 1]) < ew) {
+      n1 = index + 1;
+      ew = fabs(m_value[n1]);
+    }
+    if (ew < infinity) {
+      wew = upwind2(n1, (n1 < index) ? n1 - 1 : n1 + 1, ew);
+    }
+    
+    // Propagating along one axis alone: the lower of the two.
+    Scalar const radius(m_lsm_radius[index]);
+    Scalar const one_ns((ns < infinity) ? ns + radius / sqrt(wns) : infinity);
+    Scalar const one_ew((ew < infinity) ? ew + radius / sqrt(wew) : infinity);
+    Scalar const best(one_ns < one_ew ? one_ns : one_ew);
+    if ((ns >= infinity) || (ew >= infinity)) {
+      return best;
+    }
+    
+    // Both axes: solve wns (u - ns)^2 + wew (u - ew)^2 = radius^2,
+    // which is only valid if the result lies above both centers. As
+    // in solve(), this is done for u - ns.
+    Scalar const aa(wns + wew);
+    Scalar const ee(ew - ns);
+    Scalar const root(aa * r2(index) - wns * wew * ee * ee);
+    if (root < 0) {
+      return best;
+    }
+    Scalar const uu(ns + (wew * ee + sqrt(root)) / aa);
+    if ((uu < ns) || (uu < ew)) {
+      return best;
+    }
+    return uu;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  update(size_t index)
+  {
+    if (m_value[index] <= 0) {	// fixed cell, skip it
+      return;
+    }
+    
+    if (m_lsm_radius[index] >= infinity) { // obstacle, it'll always be at infinity
+      touch(index);
+      m_value[index] = -infinity;
+      return;
+    }
+    
+    Scalar const rhs(solve(index));
+    
+    // This probably never happens, at least in the dtrans special
+    // case, because in order to arrive here we need to have expanded
+    // one of our neighbors.
+    if (rhs >= infinity) {
+      std::cerr << "bug in update? no valid propagators\n"
+		<< "  index: " << index << " (" << (index % m_pitch - 1)
+		<< ", " << (index / m_pitch - 1) << ")\n"
+		<< "  key:   " << m_key[index] << "\n"
+		<< "  value: " << m_value[index] << "\n";
+      m_value[index] = infinity;
+      requeue(index);
+      return;
+    }
+    
+    if (rhs < m_value[index]) {
+      if (m_value[index] >= infinity) {
+	touch(index);
+      }
+      else if ((m_key[index] < 0) && m_bucketed && (m_value[index] - rhs < m_buckets.width())) {
+	// Untidy queue: an expanded cell stays frozen unless it drops
+	// by at least a bucket width. Smaller improvements come from
+	// the arbitrary order within a bucket, and chasing them would
+	// re-expand cells over and over again.
+	return;
+      }
+      else if ((m_key[index] < 0) && ( ! m_goal_x.empty())) {
+	// The heuristic of computeUntil() is not consistent with the
+	// interpolation, so expanded cells can still get lowered by a
+	// little. Reopening them lets tiny corrections ripple back and
+	// forth through the front, so computeUntil() applies them once
+	// it is done.
+	m_deferred.push_back(index);
+	return;
+      }
+      m_value[index] = rhs;
+      inheritLabel(index);
+      requeue(index);
+      invalidateGradient(index);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  size_t BasicDistanceTransform<Scalar, Cells>::
+  sweep(bool xup, bool yup, Scalar & maxchange)
+  {
+    size_t nchanged(0);
+    for (size_t jy(0); jy < m_dimy; ++jy) {
+      size_t const iy(yup ? jy : m_dimy - 1 - jy);
+      for (size_t jx(0); jx < m_dimx; ++jx) {
+	size_t const ix(xup ? jx : m_dimx - 1 - jx);
+	size_t const index(slot(ix, iy));
+	Scalar const value(m_value[index]);
+	if (value <= 0) {	// fixed cell (or known obstacle), skip it
+	  continue;
+	}
+	if (m_lsm_radius[index] >= infinity) {
+	  m_value[index] = -infinity;
+	  continue;
+	}
+	Scalar const rhs(solve(index));
+	if (rhs < value) {
+	  m_value[index] = rhs;
+	  inheritLabel(index);
+	  ++nchanged;
+	  if (value >= infinity) {
+	    maxchange = infinity;
+	  }
+	  else if (value - rhs > maxchange) {
+	    maxchange = value - rhs;
+	  }
+	}
+      }
+    }
+    return nchanged;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  size_t BasicDistanceTransform<Scalar, Cells>::
+  computeSweep(double tolerance, size_t max_sweeps)
+  {
+    // The sweeps take care of everything the queue would have done.
+    m_queue.clear();
+    m_buckets.clear();
+    m_key.fill(m_nslots, -1.0);
+    m_touched_all = true;
+    
+    static bool const xup[] = { true, false, false, true };
+    static bool const yup[] = { true, true, false, false };
+    size_t nsweeps(0);
+    size_t nquiet(0);
+    while ((nsweeps < max_sweeps) && (nquiet < 4)) {
+      Scalar maxchange(0);
+      sweep(xup[nsweeps % 4], yup[nsweeps % 4], maxchange);
+      ++nsweeps;
+      if (maxchange <= tolerance) {
+	++nquiet;
+      }
+      else {
+	nquiet = 0;
+      }
+    }
+    
+    // cached gradients are stale now
+    if ( ! m_gn.empty()) {
+      m_gn.assign(m_nslots, -1);
+    }
+    
+    return nsweeps;
   }
   
   
-  bool DistanceTransform::
-  setDist(size_t ix, size_t iy, double dist)
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  isUniform() const
   {
-    if (dist < 0) {
+    if (0 == m_grid.nCells()) {
       return false;
     }
-    
-    size_t const cell(index(ix, iy));
-    if (cell >= m_ncells) {
+    Scalar const radius(m_lsm_radius[slot(0, 0)]);
+    if (radius >= infinity) {
       return false;
     }
+    Scalar seed(1);		// seeds are <= 0
+    for (size_t iy(0); iy < m_dimy; ++iy) {
+      size_t const offset(slot(0, iy));
+      for (size_t ii(offset); ii < offset + m_dimx; ++ii) {
+	if (m_lsm_radius[ii] != radius) {
+	  return false;
+	}
+	if (m_value[ii] <= 0) {
+	  if (seed > 0) {
+	    seed = m_value[ii];
+	  }
+	  else if (m_value[ii] != seed) {
+	    return false;
+	  }
+	}
+      }
+    }
+    return seed <= 0;
+  }
+  
+  
+  /** Lower envelope of the parabolas (q - iq)^2 + ff[iq] along one
+      line of cells, evaluated at each cell (Felzenszwalb and
+      Huttenlocher, "Distance Transforms of Sampled Functions",
+      2004). Cells at DistanceTransform::infinity do not contribute
+      a parabola. This is always done in double, the intersections
+      of the parabolas need more digits than the distances. The
+      result goes to dd, and vv and zz are scratch space of at least
+      nn and nn+1 elements. If arg is non-null, it receives the root
+      of the parabola that each cell got its value from. */
+  static void
+  envelope(double const * ff, size_t nn, double * dd, size_t * vv, double * zz, size_t * arg)
+  {
+    static double const infinity(DistanceTransform::infinity);
+    size_t kk(0);
+    bool any(false);
+    for (size_t qq(0); qq < nn; ++qq) {
+      if (ff[qq] >= infinity) {
+	continue;
+      }
+      double const fq(ff[qq] + static_cast<double>(qq) * qq);
+      if ( ! any) {
+	any = true;
+	vv[0] = qq;
+	zz[0] = -infinity;
+	zz[1] = infinity;
+	continue;
+      }
+      double ss;
+      for (;;) {
+	double const vk(vv[kk]);
+	ss = (fq - (ff[vv[kk]] + vk * vk)) / (2.0 * (qq - vk));
+	if ((ss > zz[kk]) || (0 == kk)) {
+	  break;
+	}
+	--kk;
+      }
+      ++kk;
+      vv[kk] = qq;
+      zz[kk] = ss;
+      zz[kk + 1] = infinity;
+    }
     
-    m_value[cell] = -dist;	// <=0 means "fixed"
-    requeue(cell);
-    
-    return true;
+    if ( ! any) {
+      for (size_t qq(0); qq < nn; ++qq) {
+	dd[qq] = infinity;
+      }
+      return;
+    }
+    kk = 0;
+    for (size_t qq(0); qq < nn; ++qq) {
+      while (zz[kk + 1] < qq) {
+	++kk;
+      }
+      double const dq(static_cast<double>(qq) - static_cast<double>(vv[kk]));
+      dd[qq] = dq * dq + ff[vv[kk]];
+      if (arg) {
+	arg[qq] = vv[kk];
+      }
+    }
   }
   
   
-  bool DistanceTransform::
-  setSpeed(size_t ix, size_t iy, double speed)
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  computeEuclidean()
   {
-    if ((speed < 0) || (speed > 1)) {
+    if ( ! isUniform()) {
       return false;
     }
+    Scalar const radius(m_lsm_radius[slot(0, 0)]);
+    Scalar seed(0);
+    for (size_t iy(0); (iy < m_dimy) && (0 == seed); ++iy) {
+      size_t const offset(slot(0, iy));
+      for (size_t ii(offset); ii < offset + m_dimx; ++ii) {
+	if (m_value[ii] <= 0) {
+	  seed = m_value[ii];
+	  break;
+	}
+      }
+    }
     
-    size_t const cell(index(ix, iy));
-    if (cell >= m_ncells) {
-      return false;
+    // Along each column, the distance (in cells) to the nearest seed
+    // is found in one pass upwards and one pass downwards. Both
+    // passes go row by row, so they walk memory linearly. The result
+    // is stored in m_value, seeds are the only cells that end up at
+    // zero.
+    size_t const bottom(slot(0, 0));
+    for (size_t ii(bottom); ii < bottom + m_dimx; ++ii) {
+      m_value[ii] = (m_value[ii] <= 0) ? 0 : infinity;
+    }
+    // Labels travel along with the distance, see setDist().
+    bool const labeled( ! m_label.empty());
+    for (size_t iy(1); iy < m_dimy; ++iy) {
+      size_t const offset(slot(0, iy));
+      for (size_t ii(offset); ii < offset + m_dimx; ++ii) {
+	if (m_value[ii] <= 0) {
+	  m_value[ii] = 0;
+	}
+	else {
+	  Scalar const below(m_value[ii - m_pitch]);
+	  m_value[ii] = (below < infinity) ? below + 1 : infinity;
+	  if (labeled) {
+	    m_label[ii] = m_label[ii - m_pitch];
+	  }
+	}
+      }
+    }
+    for (size_t iy(m_dimy - 1); iy > 0; --iy) {
+      size_t const offset(slot(0, iy - 1));
+      for (size_t ii(offset); ii < offset + m_dimx; ++ii) {
+	Scalar const above(m_value[ii + m_pitch]);
+	if (above + 1 < m_value[ii]) {
+	  m_value[ii] = above + 1;
+	  if (labeled) {
+	    m_label[ii] = m_label[ii + m_pitch];
+	  }
+	}
+      }
     }
     
-    if (speed < epsilon) {	// obstacle
-      m_lsm_radius[cell] = infinity;
-      m_lsm_r2[cell] = infinity;
+    // Along each row, find the lower envelope of the parabolas rooted
+    // at the squared column distances.
+    std::vector<double> ff(m_dimx);
+    std::vector<size_t> vv(m_dimx);
+    std::vector<double> zz(m_dimx + 1);
+    std::vector<size_t> arg(labeled ? m_dimx : 0);
+    std::vector<size_t> column_label(labeled ? m_dimx : 0);
+    std::vector<double> row(m_dimx);
+    for (size_t iy(0); iy < m_dimy; ++iy) {
+      size_t const offset(slot(0, iy));
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	double const column(m_value[offset + ix]);
+	ff[ix] = (column < infinity) ? column * column : DistanceTransform::infinity;
+      }
+      envelope(&ff[0], m_dimx, &row[0], &vv[0], &zz[0], labeled ? &arg[0] : 0);
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	m_value[offset + ix] = narrow(row[ix]);
+      }
+      if (labeled) {
+	size_t * label(&m_label[offset]);
+	std::copy(label, label + m_dimx, column_label.begin());
+	for (size_t ix(0); ix < m_dimx; ++ix) {
+	  label[ix] = (row[ix] < infinity) ? column_label[arg[ix]] : nolabel;
+	}
+      }
     }
-    else {
-      m_lsm_radius[cell] = m_scale / speed;
-      m_lsm_r2[cell] = pow(m_lsm_radius[cell], 2);
+    
+    for (size_t iy(0); iy < m_dimy; ++iy) {
+      size_t const offset(slot(0, iy));
+      for (size_t ii(offset); ii < offset + m_dimx; ++ii) {
+	if (0 == m_value[ii]) {
+	  m_value[ii] = seed;
+	}
+	else if (m_value[ii] < infinity) {
+	  m_value[ii] = radius * sqrt(m_value[ii]) - seed;
+	}
+      }
     }
     
-    //// maybe extend this to a handle true replanning like E*, but
-    //// for now assume that the speed does not change during or after
-    //// propagation.
-    //    requeue(cell);
+    m_queue.clear();
+    m_buckets.clear();
+    m_key.fill(m_nslots, -1.0);
+    if ( ! m_gn.empty()) {
+      m_gn.assign(m_nslots, -1);
+    }
+    m_touched_all = true;
     
     return true;
   }
   
   
-  double DistanceTransform::
-  getDist(size_t ix, size_t iy) const
+  /** The ghost ring of a tile is stored as four borders: south and
+      north (nx cells each) followed by west and east (ny cells
+      each). Unknown or non-existing neighbors are at infinity. */
+  template<typename Scalar, typename Cells>
+  struct BasicDistanceTransform<Scalar, Cells>::tile_s {
+    size_t x0, y0, nx, ny;
+    std::vector<Scalar> ghost;
+    std::vector<size_t> ghost_label; /**< only used when labels are in use */
+    std::vector<size_t> changed; /**< ghost cells that got lower since the last run */
+    std::vector<size_t> seed;	 /**< (global) cells that were queued before */
+  };
+  
+  
+  template<typename Scalar, typename Cells>
+  struct BasicDistanceTransform<Scalar, Cells>::worker_s {
+    BasicDistanceTransform * dt;
+    BasicDistanceTransform * scratch; /**< tile plus ghost ring */
+    std::vector<tile_s*> const * work;
+    size_t * next;		/**< next entry of work to hand out */
+    pthread_mutex_t * mutex;	/**< protects next */
+    bool scan;			/**< scanTile() or runTile() */
+  };
+  
+  
+  /** Index of a ghost cell in the scratch transform of a tile, which
+      stores the tile at an offset of (1, 1). The index is as seen
+      through index(), use slotOf() to get at the storage. */
+  static inline size_t
+  ghost_index(size_t kk, size_t nx, size_t ny, size_t sdx)
   {
-    size_t const cell(index(ix, iy));
-    if (cell >= m_ncells) {
-      return infinity;
+    if (kk < nx) {		// south
+      return kk + 1;
+    }
+    kk -= nx;
+    if (kk < nx) {		// north
+      return kk + 1 + sdx * (ny + 1);
     }
-    return fabs(m_value[cell]);
+    kk -= nx;
+    if (kk < ny) {		// west
+      return sdx * (kk + 1);
+    }
+    kk -= ny;			// east
+    return nx + 1 + sdx * (kk + 1);
   }
   
   
-  void DistanceTransform::
-  compute(double ceiling)
+  /** Lower the ghost values (and labels, if given) of one border of
+      a tile, recording which ghost cells changed. The border cells
+      are stride indices apart, and the values of consecutive indices
+      are spacing scalars apart (see CellField). */
+  template<typename Scalar>
+  static void
+  scan_border(Scalar const * value, size_t const * label, size_t stride, size_t spacing,
+	      size_t count, Scalar * ghost, size_t * ghost_label, size_t offset,
+	      std::vector<size_t> & changed)
   {
-    while ( ! m_queue.empty()) {
-      if (m_queue.begin()->first > ceiling) {
-	break;
+    for (size_t ii(0); ii < count; ++ii) {
+      Scalar const vv(fabs(value[ii * stride * spacing]));
+      if (vv < ghost[offset + ii]) {
+	ghost[offset + ii] = vv;
+	if (label) {
+	  ghost_label[offset + ii] = label[ii * stride];
+	}
+	changed.push_back(offset + ii);
       }
-      propagate();
     }
   }
   
   
-  void DistanceTransform::
-  compute(double ceiling, FILE * dbg_fp, std::string const & dbg_prefix)
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  scanTile(tile_s & tile) const
   {
-    std::string prefix(dbg_prefix + "  ");
-    for (size_t ii(0); ! m_queue.empty(); ++ii) {
-      fprintf(stdout, "%siteration %zu\n", dbg_prefix.c_str(), ii);
-      if (m_queue.begin()->first > ceiling) {
-	fprintf(stdout, "%stop of queue %g is above ceiling %g\n",
-		dbg_prefix.c_str(), m_queue.begin()->first, ceiling);
-	break;
+    size_t const nx(tile.nx);
+    size_t const ny(tile.ny);
+    Scalar * ghost(&tile.ghost[0]);
+    size_t const * label(m_label.empty() ? 0 : &m_label[0]);
+    size_t * ghost_label(tile.ghost_label.empty() ? 0 : &tile.ghost_label[0]);
+    size_t const spacing(Cells::stride);
+    if (tile.y0 > 0) {
+      size_t const gg(slot(tile.x0, tile.y0 - 1));
+      scan_border(&m_value[gg], label ? label + gg : 0, 1, spacing, nx, ghost, ghost_label, 0,
+		  tile.changed);
+    }
+    if (tile.y0 + ny < m_dimy) {
+      size_t const gg(slot(tile.x0, tile.y0 + ny));
+      scan_border(&m_value[gg], label ? label + gg : 0, 1, spacing, nx, ghost, ghost_label, nx,
+		  tile.changed);
+    }
+    if (tile.x0 > 0) {
+      size_t const gg(slot(tile.x0 - 1, tile.y0));
+      scan_border(&m_value[gg], label ? label + gg : 0, m_pitch, spacing, ny, ghost, ghost_label,
+		  2 * nx, tile.changed);
+    }
+    if (tile.x0 + nx < m_dimx) {
+      size_t const gg(slot(tile.x0 + nx, tile.y0));
+      scan_border(&m_value[gg], label ? label + gg : 0, m_pitch, spacing, ny, ghost, ghost_label,
+		  2 * nx + ny, tile.changed);
+    }
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  runTile(tile_s & tile, BasicDistanceTransform & scratch)
+  {
+    size_t const nx(tile.nx);
+    size_t const ny(tile.ny);
+    size_t const sdx(scratch.m_dimx);
+    
+    // Everything outside the tile is a fixed cell at infinity, except
+    // the ghost ring which gets filled in below.
+    scratch.m_value.fill(scratch.m_nslots, -infinity);
+    for (size_t oy(0); oy < ny; ++oy) {
+      size_t const gg(slot(tile.x0, tile.y0 + oy));
+      size_t const ll(scratch.slot(1, oy + 1));
+      for (size_t ox(0); ox < nx; ++ox) {
+	scratch.m_value[ll + ox] = m_value[gg + ox];
+	scratch.setRadius(ll + ox, m_lsm_radius[gg + ox], r2(gg + ox));
+      }
+    }
+    if ( ! m_label.empty()) {
+      if (scratch.m_label.empty()) {
+	scratch.m_label.assign(scratch.m_nslots, nolabel);
+      }
+      for (size_t oy(0); oy < ny; ++oy) {
+	size_t const gg(slot(tile.x0, tile.y0 + oy));
+	std::copy(m_label.begin() + gg, m_label.begin() + gg + nx,
+		  scratch.m_label.begin() + scratch.slot(1, oy + 1));
+      }
+      for (size_t kk(0); kk < tile.ghost_label.size(); ++kk) {
+	scratch.m_label[scratch.slotOf(ghost_index(kk, nx, ny, sdx))] = tile.ghost_label[kk];
+      }
+    }
+    
+    // Ghost cells are fixed at the neighbors' values. The tile is
+    // already consistent with their previous values, so only those
+    // that got lower need to be expanded.
+    for (size_t kk(0); kk < tile.ghost.size(); ++kk) {
+      scratch.m_value[scratch.slotOf(ghost_index(kk, nx, ny, sdx))] = -tile.ghost[kk];
+    }
+    for (size_t ii(0); ii < tile.changed.size(); ++ii) {
+      scratch.requeue(scratch.slotOf(ghost_index(tile.changed[ii], nx, ny, sdx)));
+    }
+    for (size_t ii(0); ii < tile.seed.size(); ++ii) {
+      size_t const ix(tile.seed[ii] % m_pitch - 1 - tile.x0);
+      size_t const iy(tile.seed[ii] / m_pitch - 1 - tile.y0);
+      scratch.requeue(scratch.slot(ix + 1, iy + 1));
+    }
+    tile.changed.clear();
+    tile.seed.clear();
+    
+    scratch.compute(infinity);
+    
+    for (size_t oy(0); oy < ny; ++oy) {
+      size_t const ll(scratch.slot(1, oy + 1));
+      size_t const gg(slot(tile.x0, tile.y0 + oy));
+      for (size_t ox(0); ox < nx; ++ox) {
+	m_value[gg + ox] = scratch.m_value[ll + ox];
+      }
+      if ( ! m_label.empty()) {
+	std::copy(scratch.m_label.begin() + ll, scratch.m_label.begin() + ll + nx,
+		  m_label.begin() + gg);
       }
-      dump(stdout, prefix.c_str());
-      propagate();
     }
-    fprintf(stdout, "%sfinal\n", dbg_prefix.c_str());
-    dump(stdout, prefix.c_str());
   }
   
   
-  /** Don't call this unless you are (pretty) sure that the index is
-      on the queue. */
-  bool DistanceTransform::
-  unqueue(size_t index)
+  template<typename Scalar, typename Cells>
+  void * BasicDistanceTransform<Scalar, Cells>::
+  parallelWorker(void * arg)
   {
-    queue_it iq(m_queue.lower_bound(m_key[index]));
-    queue_it const endq(m_queue.end());
-    for (/**/; iq != endq; ++iq) {
-      if (index == iq->second) {
-	m_queue.erase(iq);
+    worker_s & worker(*static_cast<worker_s*>(arg));
+    for (;;) {
+      pthread_mutex_lock(worker.mutex);
+      size_t const it((*worker.next)++);
+      pthread_mutex_unlock(worker.mutex);
+      if (it >= worker.work->size()) {
 	break;
       }
+      if (worker.scan) {
+	worker.dt->scanTile(*(*worker.work)[it]);
+      }
+      else {
+	worker.dt->runTile(*(*worker.work)[it], *worker.scratch);
+      }
     }
-    return endq != iq;
+    return 0;
   }
   
   
-  void DistanceTransform::
-  requeue(size_t index)
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  runWorkers(std::vector<worker_s> & worker, bool scan)
   {
-    if (m_key[index] >= 0) {
-      if ( ! unqueue(index)) {
-	std::cerr << "bug in requeue? could not unqueue\n";
+    *worker[0].next = 0;
+    size_t nthreads(worker.size());
+    if (nthreads > worker[0].work->size()) {
+      nthreads = worker[0].work->size();
+    }
+    std::vector<pthread_t> thread(nthreads);
+    std::vector<bool> started(nthreads, false);
+    for (size_t ii(0); ii < nthreads; ++ii) {
+      worker[ii].scan = scan;
+    }
+    // If a thread cannot be started, the others simply get more
+    // tiles: the calling thread always takes part.
+    for (size_t ii(1); ii < nthreads; ++ii) {
+      started[ii] = (0 == pthread_create(&thread[ii], 0, parallelWorker, &worker[ii]));
+    }
+    if (nthreads > 0) {
+      parallelWorker(&worker[0]);
+    }
+    for (size_t ii(1); ii < nthreads; ++ii) {
+      if (started[ii]) {
+	pthread_join(thread[ii], 0);
       }
     }
-    m_key[index] = fabs(m_value[index]);
-    m_queue.insert(std::make_pair(m_key[index], index));
   }
   
   
-  void DistanceTransform::
-  update(size_t index)
+  template<typename Scalar, typename Cells>
+  size_t BasicDistanceTransform<Scalar, Cells>::
+  computeParallel(size_t nthreads, size_t tilesize)
   {
-    if (m_value[index] <= 0) {	// fixed cell, skip it
-      return;
+    if (0 == m_grid.nCells()) {
+      return 0;
     }
-    
-    double const radius(m_lsm_radius[index]);
-    if (radius >= infinity) { // obstacle, it'll always be at infinity
-      m_value[index] = -infinity;
-      return;
+    if (nthreads < 1) {
+      nthreads = 1;
+    }
+    if (tilesize < 1) {
+      tilesize = 1;
     }
+    size_t const tx(tilesize < m_dimx ? tilesize : m_dimx);
+    size_t const ty(tilesize < m_dimy ? tilesize : m_dimy);
+    size_t const ntx((m_dimx + tx - 1) / tx);
+    size_t const nty((m_dimy + ty - 1) / ty);
     
-    // Find all candidate propagators.
-    queue_t props;
-    if (index >= m_dimx) {	// try south
-      size_t const nbor(index - m_dimx);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < infinity) {
-	props.insert(std::make_pair(nval, nbor));
+    std::vector<tile_s> tile(ntx * nty);
+    for (size_t jy(0); jy < nty; ++jy) {
+      for (size_t jx(0); jx < ntx; ++jx) {
+	tile_s & tt(tile[jx + ntx * jy]);
+	tt.x0 = jx * tx;
+	tt.y0 = jy * ty;
+	tt.nx = (m_dimx - tt.x0 < tx) ? m_dimx - tt.x0 : tx;
+	tt.ny = (m_dimy - tt.y0 < ty) ? m_dimy - tt.y0 : ty;
+	tt.ghost.assign(2 * (tt.nx + tt.ny), infinity);
+	if ( ! m_label.empty()) {
+	  tt.ghost_label.assign(tt.ghost.size(), nolabel);
+	}
       }
     }
-    if (index < m_toprow) {	// try north
-      size_t const nbor(index + m_dimx);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < infinity) {
-	props.insert(std::make_pair(nval, nbor));
+    
+    // Whatever is on the queue seeds the tiles. The queue itself is
+    // not needed anymore.
+    for (size_t ii(0); ii < m_nslots; ++ii) {
+      if (m_key[ii] >= 0) {
+	tile[(ii % m_pitch - 1) / tx + ntx * ((ii / m_pitch - 1) / ty)].seed.push_back(ii);
       }
     }
-    size_t const ix(index % m_dimx);
-    if (ix > 0) {		// try west
-      size_t const nbor(index - 1);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < infinity) {
-	props.insert(std::make_pair(nval, nbor));
-      }
+    m_queue.clear();
+    m_buckets.clear();
+    m_key.fill(m_nslots, -1.0);
+    m_touched_all = true;
+    
+    if (nthreads > tile.size()) {
+      nthreads = tile.size();
+    }
+    std::vector<tile_s*> work;
+    size_t next(0);
+    pthread_mutex_t mutex;
+    pthread_mutex_init(&mutex, 0);
+    std::vector<worker_s> worker(nthreads);
+    for (size_t ii(0); ii < nthreads; ++ii) {
+      worker[ii].dt = this;
+      worker[ii].scratch = new BasicDistanceTransform(tx + 2, ty + 2, m_scale);
+      worker[ii].scratch->m_second_order = m_second_order;
+      worker[ii].work = &work;
+      worker[ii].next = &next;
+      worker[ii].mutex = &mutex;
+      worker[ii].scan = true;
     }
-    if (ix < m_rightcol) {	// try east
-      size_t const nbor(index + 1);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < infinity) {
-	props.insert(std::make_pair(nval, nbor));
+    
+    size_t nrounds(0);
+    for (;;) {
+      work.resize(tile.size());
+      for (size_t ii(0); ii < tile.size(); ++ii) {
+	work[ii] = &tile[ii];
+      }
+      runWorkers(worker, true);
+      
+      work.clear();
+      for (size_t ii(0); ii < tile.size(); ++ii) {
+	if (( ! tile[ii].changed.empty()) || ( ! tile[ii].seed.empty())) {
+	  work.push_back(&tile[ii]);
+	}
+      }
+      if (work.empty()) {
+	break;
       }
+      runWorkers(worker, false);
+      ++nrounds;
     }
     
-    // This probably never happens, at least in the dtrans special
-    // case, because in order to arrive here we need to have expanded
-    // one of our neighbors.
-    if (props.empty()) {
-      std::cerr << "bug in update? no valid propagators\n"
-		<< "  index: " << index << " (" << (index % m_dimx) << ", " << (index / m_dimx) << ")\n"
-		<< "  key:   " << m_key[index] << "\n"
-		<< "  value: " << m_value[index] << "\n";
-      m_value[index] = infinity;
-      requeue(index);
-      return;
+    for (size_t ii(0); ii < nthreads; ++ii) {
+      delete worker[ii].scratch;
     }
+    pthread_mutex_destroy(&mutex);
     
-    queue_it ip(props.begin());
-    queue_it endp(props.end());
-    double const primary(ip->first);
-    bool const northsouth(ix == (ip->second % m_dimx));
-    
-    // Try to find a valid secondary for the interpolation: it needs
-    // to lie along a different axis than the primary, and it needs to
-    // be closer than m_scale/speed to it.
-    double const r2(m_lsm_r2[index]); // cached square radius
-    double const p2(pow(primary, 2));
-    for (++ip; endp != ip; ++ip) {
-      bool const valid(northsouth ^ (ix == (ip->second % m_dimx)));
-      if (valid) {
-	double const secondary(ip->first);
-	if (radius > secondary - primary) {
-	  // Found it!
-	  double const bb(primary + secondary);
-	  double const cc((p2 + pow(secondary, 2) - r2) / 2.0);
-	  double const root(pow(bb, 2) - 4.0 * cc);
-	  double const rhs((bb + sqrt(root)) / 2.0);
-	  if (rhs < m_value[index]) {
-	    m_value[index] = rhs;
-	    requeue(index);
-	    return;
-	  }
-	}
-      }
+    // cached gradients are stale now
+    if ( ! m_gn.empty()) {
+      m_gn.assign(m_nslots, -1);
     }
     
-    double const rhs(primary + radius);
-    if (rhs < m_value[index]) {
-      m_value[index] = rhs;
-      requeue(index);
+    return nrounds;
+  }
+  
+  
+  /** Shared state of the threads of computeBatch(). */
+  template<typename transform_t>
+  struct batch_s {
+    std::vector<transform_t*> const * batch;
+    size_t next;		/**< next entry of batch to hand out */
+    pthread_mutex_t mutex;	/**< protects next */
+  };
+  
+  
+  template<typename transform_t>
+  static void * batch_worker(void * arg)
+  {
+    batch_s<transform_t> & shared(*static_cast<batch_s<transform_t>*>(arg));
+    for (;;) {
+      pthread_mutex_lock(&shared.mutex);
+      size_t const it(shared.next++);
+      pthread_mutex_unlock(&shared.mutex);
+      if (it >= shared.batch->size()) {
+	break;
+      }
+      (*shared.batch)[it]->compute(transform_t::infinity);
     }
+    return 0;
   }
   
   
-  size_t DistanceTransform::
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  computeBatch(std::vector<BasicDistanceTransform*> const & batch, size_t nthreads)
+  {
+    if (nthreads > batch.size()) {
+      nthreads = batch.size();
+    }
+    batch_s<BasicDistanceTransform> shared;
+    shared.batch = &batch;
+    shared.next = 0;
+    pthread_mutex_init(&shared.mutex, 0);
+    // As in runWorkers(), the calling thread always takes part.
+    std::vector<pthread_t> thread(nthreads);
+    std::vector<bool> started(nthreads, false);
+    for (size_t ii(1); ii < nthreads; ++ii) {
+      started[ii] = (0 == pthread_create(&thread[ii], 0, batch_worker<BasicDistanceTransform>,
+					 &shared));
+    }
+    batch_worker<BasicDistanceTransform>(&shared);
+    for (size_t ii(1); ii < nthreads; ++ii) {
+      if (started[ii]) {
+	pthread_join(thread[ii], 0);
+      }
+    }
+    pthread_mutex_destroy(&shared.mutex);
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  size_t BasicDistanceTransform<Scalar, Cells>::
   pop()
   {
-    queue_it iq(m_queue.begin());
-    size_t const index(iq->second);
-    m_queue.erase(iq);
+    size_t const index(m_bucketed ? m_buckets.pop() : m_queue.pop());
     m_key[index] = -1;
     return index;
   }
   
   
-  bool DistanceTransform::
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
   propagate()
   {
-    if (m_queue.empty()) {
+    if (queueEmpty()) {
       return false;
     }
-    
-    size_t const index(pop());
-    if (index >= m_dimx) {	// south
-      update(index - m_dimx);
-    }
-    if (index < m_toprow) {	// north
-      update(index + m_dimx);
-    }
-    size_t const ix(index % m_dimx);
-    if (ix > 0) {		// west
-      update(index - 1);
-    }
-    if (ix < m_rightcol) {	// east
-      update(index + 1);
-    }      
-    
+    expand(pop());
     return true;
   }
   
   
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  expand(size_t index)
+  {
+    // Cells on the border are fixed, update() skips them.
+    update(index - m_pitch);	// south
+    update(index + m_pitch);	// north
+    update(index - 1);		// west
+    update(index + 1);		// east
+  }
+  
+  
   static void pval(FILE * fp, double val)
   {
     if (isinf(val)) {
@@ -340,7 +1854,8 @@ namespace dtrans {
   }
   
   
-  void DistanceTransform::
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
   dump(FILE * fp, std::string const & prefix) const
   {
     fprintf(fp, "%skey\n", prefix.c_str());
@@ -349,7 +1864,7 @@ namespace dtrans {
       --iy;
       fprintf(fp, "%s  ", prefix.c_str());
       for (size_t ix(0); ix < m_dimx; ++ix) {
-	pval(fp, m_key[index(ix, iy)]);
+	pval(fp, m_key[slot(ix, iy)]);
       }
       fprintf(fp, "\n");
     }
@@ -360,14 +1875,15 @@ namespace dtrans {
       --iy;
       fprintf(fp, "%s  ", prefix.c_str());
       for (size_t ix(0); ix < m_dimx; ++ix) {
-	pval(fp, m_value[index(ix, iy)]);
+	pval(fp, m_value[slot(ix, iy)]);
       }
       fprintf(fp, "\n");
     }
   }
   
   
-  void DistanceTransform::
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
   dumpSpeed(FILE * fp, std::string const & prefix) const
   {
     fprintf(fp, "%sspeed\n", prefix.c_str());
@@ -376,7 +1892,7 @@ namespace dtrans {
       --iy;
       fprintf(fp, "%s  ", prefix.c_str());
       for (size_t ix(0); ix < m_dimx; ++ix) {
-	pval(fp, m_scale / m_lsm_radius[index(ix, iy)]);
+	pval(fp, m_scale / m_lsm_radius[slot(ix, iy)]);
       }
       fprintf(fp, "\n");
     }
@@ -387,42 +1903,52 @@ namespace dtrans {
       --iy;
       fprintf(fp, "%s  ", prefix.c_str());
       for (size_t ix(0); ix < m_dimx; ++ix) {
-	pval(fp, m_lsm_radius[index(ix, iy)]);
+	pval(fp, m_lsm_radius[slot(ix, iy)]);
       }
       fprintf(fp, "\n");
     }
   }
   
   
-  void DistanceTransform::
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
   dumpQueue(FILE * fp, std::string const & prefix) const
   {
-    if (m_queue.empty()) {
+    if (queueEmpty()) {
       fprintf(fp, "%sempty queue\n", prefix.c_str());
       return;
     }
     
+    // Neither queue keeps its elements sorted, so collect them from
+    // the key map. This is for debugging, so the cost is fine.
+    queue_t sorted;
+    for (size_t ii(0); ii < m_nslots; ++ii) {
+      if (m_key[ii] >= 0) {
+	sorted.insert(std::make_pair(m_key[ii], ii));
+      }
+    }
+    
     fprintf(fp, "%squeue: [key index value]\n", prefix.c_str());
-    for (queue_cit iq(m_queue.begin()); iq != m_queue.end(); ++iq) {
+    for (queue_cit iq(sorted.begin()); iq != sorted.end(); ++iq) {
       fprintf(fp, "%s  ", prefix.c_str());
       pval(fp, m_key[iq->second]);
-      fprintf(fp, "  (%zu, %zu)", iq->second % m_dimx, iq->second / m_dimx);
+      fprintf(fp, "  (%zu, %zu)", iq->second % m_pitch - 1, iq->second / m_pitch - 1);
       fprintf(fp, "  ");
       pval(fp, m_value[iq->second]);
-      if (fabs(m_key[iq->second]) != iq->first) {
-	fprintf(fp, "  ERROR queue key (%g) mismatch", iq->first);
+      if ( ! queueContains(iq->second)) {
+	fprintf(fp, "  ERROR cell has a key but is not queued");
       }
       fprintf(fp, "\n");
     }
     
     fprintf(fp, "%swavefront:\n", prefix.c_str());
-    double const front_key(m_queue.begin()->first);
+    double const front_key(queueTopKey());
     size_t iy(m_dimy);
     while (iy > 0) {
       --iy;
       fprintf(fp, "%s  ", prefix.c_str());
       for (size_t ix(0); ix < m_dimx; ++ix) {
-	size_t const idx(index(ix, iy));
+	size_t const idx(slot(ix, iy));
 	char const * cc(0);
 	bool const fixed(m_value[idx] <= 0);
 	if (m_key[idx] < 0) {
@@ -456,12 +1982,16 @@ namespace dtrans {
   }
   
   
-  void DistanceTransform::
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
   stat(double & minval, double & maxval, double & minkey, double & maxkey) const
   {
     minval = infinity;
     maxval = - infinity;
-    for (size_t ii(0); ii < m_ncells; ++ii) {
+    minkey = infinity;
+    maxkey = - infinity;
+    // the border is at infinity and never queued, so it drops out
+    for (size_t ii(0); ii < m_nslots; ++ii) {
       double const val(fabs(m_value[ii]));
       if (val < infinity) {
 	if (val > maxval) {
@@ -471,184 +2001,240 @@ namespace dtrans {
 	  minval = val;
 	}
       }
-    }
-    
-    if (m_queue.empty()) {
-      minkey = infinity;
-      maxkey = - infinity;
-    }
-    else {
-      minkey = m_queue.begin()->first;
-      maxkey = m_queue.rbegin()->first;
+      double const key(m_key[ii]);
+      if (key >= 0) {
+	if (key > maxkey) {
+	  maxkey = key;
+	}
+	if (key < minkey) {
+	  minkey = key;
+	}
+      }
     }
   }
   
   
-  double DistanceTransform::
+  template<typename Scalar, typename Cells>
+  double BasicDistanceTransform<Scalar, Cells>::
   getTopKey() const
   {
-    if (m_queue.empty()) {
+    if (queueEmpty()) {
       return infinity;
     }
-    return m_queue.begin()->first;
+    return queueTopKey();
+  }
+  
+  
+  /** Upwind gradient of a cell at the given height, from the values
+      of its four neighbors. Beware of confusions between x and y as
+      well as + and - below. The idea is to use the height difference
+      wrt the lowest downwind neighbor along each axis, counted
+      positive when we go along positive x or y and negative
+      otherwise. A neighbor that is not lower than the cell does not
+      contribute, so missing neighbors can be passed as the height
+      itself. Ties go to the south and west neighbors. */
+  template<typename Scalar>
+  static inline size_t
+  gradient_kernel(Scalar height, Scalar south, Scalar north, Scalar west, Scalar east,
+		  Scalar & gx, Scalar & gy)
+  {
+    size_t count(0);
+    gx = 0;
+    gy = 0;
+    if ((south < height) || (north < height)) {
+      ++count;
+      gy = (south <= north) ? height - south : north - height;
+    }
+    if ((west < height) || (east < height)) {
+      ++count;
+      gx = (west <= east) ? height - west : east - height;
+    }
+    return count;
   }
   
   
-  size_t DistanceTransform::
+  template<typename Scalar, typename Cells>
+  size_t BasicDistanceTransform<Scalar, Cells>::
   computeGradient(size_t ix, size_t iy,
 		  double & gx, double & gy) const
   {
-    size_t const ixy(index(ix, iy));
+    if ( ! isValid(ix, iy)) {
+      gx = 0;
+      gy = 0;
+      return 0;
+    }
+    
+    size_t const ixy(slot(ix, iy));
     
-    if (m_gn[ixy] >= 0) {
+    if (m_gn.empty()) {
+      // allocated on first use, transforms that never compute
+      // gradients save the memory
+      m_gx.assign(m_nslots, 0.0);
+      m_gy.assign(m_nslots, 0.0);
+      m_gn.assign(m_nslots, -1);
+    }
+    else if (m_gn[ixy] >= 0) {
       gx = m_gx[ixy];
       gy = m_gy[ixy];
       return m_gn[ixy];
     }
     
-    double const height(fabs(m_value[ixy]));
-    
-    // Find all downwind neighbors.
-    queue_t dwn;
-    if (iy > 0) {		// try south
-      size_t const nbor(ixy - m_dimx);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < height) {
-	dwn.insert(std::make_pair(nval, nbor));
-      }
-    }
-    if (ixy < m_toprow) {	// try north
-      size_t const nbor(ixy + m_dimx);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < height) {
-	dwn.insert(std::make_pair(nval, nbor));
-      }
+    // The border is at infinity, which is never below the cell.
+    Scalar const height(fabs(m_value[ixy]));
+    size_t const count(gradient_kernel(height,
+				       fabs(m_value[ixy - m_pitch]),
+				       fabs(m_value[ixy + m_pitch]),
+				       fabs(m_value[ixy - 1]),
+				       fabs(m_value[ixy + 1]),
+				       m_gx[ixy], m_gy[ixy]));
+    if (m_value[ixy] >= infinity) {
+      touch(ixy);		// cells with a distance are already on the list
     }
-    if (ix > 0) {		// try west
-      size_t const nbor(ixy - 1);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < height) {
-	dwn.insert(std::make_pair(nval, nbor));
-      }
+    gx = m_gx[ixy];
+    gy = m_gy[ixy];
+    m_gn[ixy] = count;
+    m_gn_used = true;
+    return count;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  bool BasicDistanceTransform<Scalar, Cells>::
+  computeGradientField(size_t x0, size_t y0, size_t nx, size_t ny,
+		       double * gx, double * gy, size_t * count) const
+  {
+    if ((x0 + nx > m_dimx) || (y0 + ny > m_dimy)) {
+      return false;
     }
-    if (ix < m_rightcol) {	// try east
-      size_t const nbor(ixy + 1);
-      double const nval(fabs(m_value[nbor]));
-      if (nval < height) {
-	dwn.insert(std::make_pair(nval, nbor));
-      }
+    if ((0 == nx) || (0 == ny)) {
+      return true;
     }
     
-    // Compute gradient based on 0, 1, or 2 downwind neighbors.
-    
-    if (dwn.empty()) {
-      m_gx[ixy] = 0;
-      m_gy[ixy] = 0;
-      m_gn[ixy] = 0;
-      gx = 0;
-      gy = 0;
-      return 0;
+    for (size_t iy(y0); iy < y0 + ny; ++iy) {
+      // Neighbors beyond the edge of the grid are in the border,
+      // which is at infinity and thus never below the cell.
+      size_t const row(slot(0, iy));
+      size_t const south(row - m_pitch);
+      size_t const north(row + m_pitch);
+      size_t const off((iy - y0) * nx);
+      double * rgx(gx + off);
+      double * rgy(gy + off);
+      size_t * rcount(count + off);
+      
+      // This is the bulk of the work, and it is written such that the
+      // compiler can vectorize it.
+      for (size_t ix(x0); ix < x0 + nx; ++ix) {
+	Scalar const height(fabs(m_value[row + ix]));
+	Scalar const ss(fabs(m_value[south + ix]));
+	Scalar const nn(fabs(m_value[north + ix]));
+	Scalar const ww(fabs(m_value[row + ix - 1]));
+	Scalar const ee(fabs(m_value[row + ix + 1]));
+	bool const has_y((ss < height) || (nn < height));
+	bool const has_x((ww < height) || (ee < height));
+	rgy[ix - x0] = has_y ? ((ss <= nn) ? height - ss : nn - height) : 0;
+	rgx[ix - x0] = has_x ? ((ww <= ee) ? height - ww : ee - height) : 0;
+	rcount[ix - x0] = static_cast<size_t>(has_x) + static_cast<size_t>(has_y);
+      }
     }
     
-    // Beware of confusions between x and y as well as + and -
-    // below. The idea is to use the height difference wrt the lowest
-    // neighbor for either gx or gy, depending on whether it neighbors
-    // the current cell along x or y. Then, if there is a second
-    // lowest neighbor that lies along the other coordinate axis, use
-    // that height difference to fill in the other gradient
-    // coordinate. Height differences must be counted positive when we
-    // go along positive x or y, and negative otherwise. By the checks
-    // above we know that all candidate neighbors lie below the
-    // current cell, so we can switch sign simply by choosing the
-    // order of terms in the substractions.
-    
-    queue_it idwn(dwn.begin());
-    queue_it endwn(dwn.end());
-    double const nval0(idwn->first);
-    size_t const nidx0(idwn->second);
-    bool const lowest_nbor_along_y(ix == (nidx0 % m_dimx));
-    
-    // Fill in gx or gy based on the direction to the lowest neighbor.
-    if (lowest_nbor_along_y) {
-      if (ixy < nidx0) {	// lowest neighbor at (ix, iy+1) so gy < 0
-	gy = nval0 - height;
+    return true;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  resetDist()
+  {
+    m_queue.clear();
+    m_buckets.clear();
+    if (m_touched_all) {
+      m_value.fill(m_nslots, infinity);
+      m_key.fill(m_nslots, -1.0);
+      if ( ! m_label.empty()) {
+	m_label.assign(m_nslots, nolabel);
       }
-      else {			// else it's at (ix, iy-1) and thus gy > 0
-	gy = height - nval0;
+      if ( ! m_gn.empty()) {
+	m_gx.assign(m_nslots, 0.0);
+	m_gy.assign(m_nslots, 0.0);
+	m_gn.assign(m_nslots, -1);
       }
+      initBorder();
     }
     else {
-      if (ixy < nidx0) {	// lowest neighbor is at (ix+1, iy) so gx < 0
-	gx = nval0 - height;
+      for (size_t ii(0); ii < m_touched.size(); ++ii) {
+	size_t const cell(m_touched[ii]);
+	m_value[cell] = infinity;
+	m_key[cell] = -1;
       }
-      else {			// else it's at (ix-1, iy) and thus gx > 0
-	gx = height - nval0;
-      }
-    }
-    
-    // Find a second lowest neighbor that lies along the other axis.
-    for (++idwn; endwn != idwn; ++idwn) {
-      size_t const nidx1(idwn->second);
-      if (lowest_nbor_along_y ^ (ix == (nidx1 % m_dimx))) {
-	double const nval1(idwn->first);
-	// Fill in "the other" gx or gy based on the axis of the
-	// second lowest neighbor.
-	if (lowest_nbor_along_y) {
-	  if (ixy < nidx1) { // SECOND lowest neighbor is at (ix+1, iy) so gx < 0
-	    gx = nval1 - height;
-	  }
-	  else {	    // else it's at (ix-1, iy) and thus gx > 0
-	    gx = height - nval1;
-	  }
+      if ( ! m_label.empty()) {
+	for (size_t ii(0); ii < m_touched.size(); ++ii) {
+	  m_label[m_touched[ii]] = nolabel;
 	}
-	else {
-	  if (ixy < nidx1) { // SECOND lowest neighbor is at (ix, iy+1) so gy < 0
-	    gy = nval1 - height;
-	  }
-	  else {	    // else it's at (ix, iy-1) and thus gy > 0
-	    gy = height - nval1;
-	  }
+      }
+      if ( ! m_gn.empty()) {
+	for (size_t ii(0); ii < m_touched.size(); ++ii) {
+	  size_t const cell(m_touched[ii]);
+	  m_gx[cell] = 0;
+	  m_gy[cell] = 0;
+	  m_gn[cell] = -1;
 	}
-	m_gx[ixy] = gx;
-	m_gy[ixy] = gy;
-	m_gn[ixy] = 2;
-	return 2;
       }
     }
-    
-    // We did not find a second_lowest neighbor that lies
-    // perpendicular to the lowest, so we have to set that
-    // contribution to zero.
-    if (lowest_nbor_along_y) {
-      gx = 0;
-    }
-    else {
-      gy = 0;
+    m_touched.clear();
+    m_touched_all = false;
+    m_gn_used = false;
+  }
+  
+  
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  resetSpeed()
+  {
+    ownSpeed();
+    Scalar const radius(m_scale);
+    Scalar const r2(pow(m_scale, 2.0));
+    for (size_t iy(0); iy < m_dimy; ++iy) {
+      size_t const offset(slot(0, iy));
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	setRadius(offset + ix, radius, r2);
+      }
     }
-    m_gx[ixy] = gx;
-    m_gy[ixy] = gy;
-    m_gn[ixy] = 1;
-    return 1;
   }
   
   
-  void DistanceTransform::
-  resetDist()
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  copyValues(std::vector<double> & values) const
   {
-    m_value.assign(m_ncells, infinity);
-    m_key.assign(m_ncells, -1.0);
-    m_queue.clear();
-    m_gx.assign(m_ncells, 0.0);
-    m_gy.assign(m_ncells, 0.0);
-    m_gn.assign(m_ncells, -1);
+    values.resize(m_grid.nCells());
+    for (size_t iy(0); iy < m_dimy; ++iy) {
+      size_t const offset(slot(0, iy));
+      for (size_t ix(0); ix < m_dimx; ++ix) {
+	values[index(ix, iy)] = m_value[offset + ix];
+      }
+    }
   }
   
   
-  void DistanceTransform::
-  resetSpeed()
+  template<typename Scalar, typename Cells>
+  void BasicDistanceTransform<Scalar, Cells>::
+  copyLabels(std::vector<size_t> & labels) const
   {
-    m_lsm_radius.assign(m_ncells, m_scale);
-    m_lsm_r2.assign(m_ncells, pow(m_scale, 2.0));
+    if (m_label.empty()) {
+      labels.clear();
+      return;
+    }
+    labels.resize(m_grid.nCells());
+    for (size_t iy(0); iy < m_dimy; ++iy) {
+      std::copy(m_label.begin() + slot(0, iy), m_label.begin() + slot(0, iy) + m_dimx,
+		labels.begin() + index(0, iy));
+    }
   }
   
+  
+  template class BasicDistanceTransform<double, SplitCells>;
+  template class BasicDistanceTransform<double, PackedCells>;
+  template class BasicDistanceTransform<float, SplitCells>;
+  template class BasicDistanceTransform<float, PackedCells>;
+  
 }
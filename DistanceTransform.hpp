@@ -32,10 +32,17 @@
 #ifndef DTRANS_DISTANCE_TRANSFORM_HPP
 #define DTRANS_DISTANCE_TRANSFORM_HPP
 
+#include "DaryHeap.hpp"
+#include "BucketQueue.hpp"
+#include "SpeedMap.hpp"
+#include "GridIndex.hpp"
+#include "CellLayout.hpp"
 #include <vector>
 #include <map>
 #include <string>
 #include <stdio.h>
+#include <stddef.h>
+#include <math.h>
 
 
 /** \namespace dtrans Contains all distance transformation entities (classes, functions, etc). */
@@ -49,32 +56,132 @@ namespace dtrans {
      e.g. for determining the distance from any location to the
      nearest obstacle, or to compute a navigation function that
      encodes cost-optimal paths from any location to some goal set.
+     
+     All per-cell storage is allocated for the whole grid up
+     front. For grids of which only a small part ever gets reached,
+     or for fields that are only needed up to some distance (narrow
+     band), see SparseDistanceTransform.
+     
+     Internally, the grid is stored with a border of one extra cell
+     on each side. Border cells are fixed obstacles, so they never
+     propagate and never get updated, and the inner loops can visit
+     the four neighbors of any cell without checking for the edges
+     of the grid or dividing by the row length. None of this shows
+     through the interface: index() and the arrays it refers to use
+     the plain layout without border.
+     
+     How the per-cell data is arranged in memory is up to the Cells
+     policy, see SplitCells (which is what DistanceTransform uses) and
+     PackedCells (PackedDistanceTransform). The results are the same
+     either way.
+     
+     The Scalar type is used for everything that is stored per cell:
+     distances, queue keys, LSM radii, and cached gradients, and for
+     the arithmetic of the upwind update. With float, that takes half
+     the memory and bandwidth of double (FloatDistanceTransform),
+     which is plenty for speed maps that come from 8-bit images. The
+     interface is in double either way.
    */  
-  class DistanceTransform
+  template<typename Scalar, typename Cells>
+  class BasicDistanceTransform
   {
   public:
+    /** The speed map that goes with this transform. */
+    typedef BasicSpeedMap<Scalar> speed_map_t;
+    
     /** A (very large) positive number that will be considered
-	equivalent to infinity by the distance transform. */
-    static double const infinity;
+	equivalent to infinity by the distance transform: the largest
+	finite Scalar. Distances that are not smaller than this are
+	stored as infinity. */
+    static Scalar const infinity;
     
     /** A small positive number that will be considered equivalent to
-	zero by the distance transform (only for speeds). */
-    static double const epsilon;
+	zero by the distance transform (only for speeds). This is
+	larger for float, so that the squared radius of the slowest
+	cell does not drown the others in the update. */
+    static Scalar const epsilon;
+    
+    /** Label of cells that have not been reached from any labeled
+	seed, see setDist(). */
+    static size_t const nolabel;
+    
+    /** How the propagation front is ordered, see setQueuePolicy(). */
+    typedef enum {
+      /** Always expand the cell with the smallest key (indexed
+	  binary heap). This is the default. */
+      EXACT_QUEUE,
+      /** Expand any cell from the lowest bucket of keys (untidy
+	  bucket queue). Faster, but the distances are only accurate
+	  up to the bucket width. */
+      BUCKET_QUEUE
+    } queue_policy_t;
+    
+    /** Finite-difference stencil of the upwind update, see
+	setStencil(). */
+    typedef enum {
+      /** One neighbor per axis. This is the default. */
+      FIRST_ORDER,
+      /** Two cells per axis where available, for a second-order
+	  accurate interpolation. */
+      SECOND_ORDER
+    } stencil_t;
+    
+    /** Outcome of computeUntil(). Unreached is zero, so the result
+	can still be tested like a bool. */
+    typedef enum {
+      /** Some target lies outside the grid or cannot be reached, or
+	  the heuristic weight is out of range. */
+      UNREACHED = 0,
+      /** All targets have been expanded, but with a heuristic: their
+	  distances are upper bounds that later propagation may still
+	  lower. */
+      REACHED_UPPER_BOUND,
+      /** All targets have been expanded and nothing left in the
+	  queue can lower their distances any further. */
+      REACHED_FINAL
+    } reach_t;
+    
+    /** What computeFor() and computeForTime() got done. */
+    struct progress_s {
+      size_t expansions;	/**< number of cells that were expanded */
+      double top_key;		/**< key at the top of the queue afterwards,
+				   or infinity if the queue is empty */
+    };
     
     /** A two-dimensional grid of cells, each of which stores its
 	distance to some initial level set. Plus some auxiliary data
 	and methods to propagate the distance transform out from the
 	initial set. */
-    DistanceTransform(/** Dimension (number of cells) along the X direction. */
-		      size_t dimx,
-		      /** Dimension (number of cells) along the Y direction. */
-		      size_t dimy,
-		      /** Scale of the cells: the length of one side
-			  of one cell is considered to be these many
-			  units. E.g. if the scale=0.1 then it will
-			  take 10 cells for the distance to grow by
-			  1. */
-		      double scale);
+    BasicDistanceTransform(/** Dimension (number of cells) along the X direction. */
+			   size_t dimx,
+			   /** Dimension (number of cells) along the Y direction. */
+			   size_t dimy,
+			   /** Scale of the cells: the length of one side
+			       of one cell is considered to be these many
+			       units. E.g. if the scale=0.1 then it will
+			       take 10 cells for the distance to grow by
+			       1. */
+			   double scale);
+    
+    /** Create a transform on top of an existing speed map, which
+	determines the dimensions and scale. The map is shared (not
+	copied) until one of the transforms changes a speed, see
+	SpeedMap. The exception is a map of PackedCells used for
+	SplitCells: it lacks the squares of the radii, so the split
+	transform starts out with a copy that has them. */
+    explicit BasicDistanceTransform(speed_map_t const * speed);
+    
+    /** Copy the distances, queue, and caches of another transform,
+	and share its speed map. */
+    BasicDistanceTransform(BasicDistanceTransform const & orig);
+    
+    ~BasicDistanceTransform();
+    
+    /** The speed map of this transform, for sharing it with other
+	transforms. It stays valid as long as this transform does not
+	change any speeds and is not destroyed.
+    */
+    inline speed_map_t const * speedMap() const { return m_speed; }
     
     /** Check if a grid index is valid.
 	
@@ -82,7 +189,7 @@ namespace dtrans {
 	(i.e. they lie within the grid dimensions specified at
 	construction time). */
     inline bool isValid(size_t ix, size_t iy) const
-    { return (ix < m_dimx) && (iy < m_dimy); }
+    { return m_grid.isValid(ix, iy); }
     
     /** Dimension along X.
 	
@@ -111,6 +218,22 @@ namespace dtrans {
     */
     bool setDist(size_t ix, size_t iy, double dist);
     
+    /** Like setDist(), but also give the seed a label, e.g. the ID of
+	the robot or task it stands for. Labels propagate along with
+	the distance: each cell inherits the label of the neighbor it
+	gets its distance from (the lowest one), so after computing,
+	getLabel() tells which source each cell is closest to. That
+	gives the distance field and the Voronoi partition of the
+	sources in one pass, with any of the compute methods.
+	
+	\note Label storage is allocated by the first call to this
+	method. Seeds set in any other way, and cells that are not
+	reached from any labeled seed, get DistanceTransform::nolabel.
+	
+	\return See setDist().
+    */
+    bool setDist(size_t ix, size_t iy, double dist, size_t label);
+    
     /** Set the propagation speed for a cell (given by its X and Y
 	index). These speeds are normalized to the range [0, 1], where
 	zero speed means that the cell is an obstacle and unit speed
@@ -118,22 +241,91 @@ namespace dtrans {
 	smaller than zero or larger than one, it is ignored and this
 	method returns false.
 	
-	\note You should set speeds before propagating the distance
-	transform. Contrary to E*, this code does not support changing
-	the speed on the fly.
+	\note You can change speeds after propagating the distance
+	transform, like in E*. Lowering a speed invalidates the cells
+	whose distance depended on this one (their distance goes back
+	to infinity), and raising a speed lowers the cell's
+	distance. Either way, the affected cells are put back on the
+	queue, and the next call to compute() repairs only the region
+	that actually changes. Seeds (see setDist()) keep their
+	distance whatever their speed.
 	
 	\return True if the given speed and indices were valid, false
 	otherwise.
     */
     bool setSpeed(size_t ix, size_t iy, double speed);
     
+    /** Set the speeds of many cells from a buffer of floats, which
+	is much faster than calling setSpeed() for each cell. Row iy
+	of the grid is read from speed + (iy - y0) * stride, and each
+	row has dimX() entries. The stride is given in elements, and
+	it can be negative, e.g. for images that are stored top row
+	first. Only the rows y0 to y0+ny-1 are touched (ny gets
+	clipped to the grid).
+	
+	Speed changes after propagation are handled the same way as
+	in setSpeed().
+	
+	\return False if some of the speeds were invalid (those cells
+	are left as they were) or if y0 lies outside the grid.
+    */
+    bool setSpeedBuffer(float const * speed, ptrdiff_t stride,
+			size_t y0 = 0, size_t ny = static_cast<size_t>(-1));
+    
+    /** Same as the float version of setSpeedBuffer(), but the buffer
+	contains bytes (e.g. pixels) which are translated to speeds
+	using a lookup table of 256 entries. The table is checked and
+	converted once, so no division or anything else happens per
+	cell.
+	
+	\return False if y0 lies outside the grid or if the lookup
+	table contains invalid speeds (in which case nothing is
+	changed).
+    */
+    bool setSpeedBuffer(unsigned char const * data, ptrdiff_t stride,
+			/** speeds for each byte value (256 entries) */
+			double const * lut,
+			size_t y0 = 0, size_t ny = static_cast<size_t>(-1));
+    
+    /** Set the distances of many cells from a buffer of floats, the
+	bulk version of setDist(). The buffer layout is the same as
+	for setSpeedBuffer(). Entries that are negative, NaN, or at
+	least infinity are skipped, they do not seed anything. All
+	new seeds are added to the queue in one go, which is linear
+	in the size of the queue instead of O(n log n).
+	
+	\return False if y0 lies outside the grid.
+    */
+    bool setDistBuffer(float const * dist, ptrdiff_t stride,
+		       size_t y0 = 0, size_t ny = static_cast<size_t>(-1));
+    
+    /** Same as the float version of setDistBuffer(), but the buffer
+	contains bytes which are translated to distances using a
+	lookup table of 256 entries. Use a negative distance in the
+	table for byte values that should not seed anything.
+	
+	\return False if y0 lies outside the grid.
+    */
+    bool setDistBuffer(unsigned char const * data, ptrdiff_t stride,
+		       /** distances for each byte value (256 entries) */
+		       double const * lut,
+		       size_t y0 = 0, size_t ny = static_cast<size_t>(-1));
+    
     /** Get the distance of a cell.
 	
 	\return The distance value of a cell (given by its X and Y
 	index). If the cell is invalid (i.e. it lies outside the
-	grid), then DistanceTransform::infinity is returned. */
+	grid), then infinity is returned. */
     double getDist(size_t ix, size_t iy) const;
     
+    /** Get the label of the source that a cell is closest to, see
+	setDist().
+	
+	\return The label, or DistanceTransform::nolabel if the cell
+	has not been reached from a labeled seed (or lies outside the
+	grid). */
+    size_t getLabel(size_t ix, size_t iy) const;
+    
     /** Propagate the distance transform until a maximum distance has
 	been reached or the entire grid has been updated. Repeatedly
 	calls propagate() until the top of the queue lies above the
@@ -154,10 +346,199 @@ namespace dtrans {
 		     no limit) */
 		 double ceiling);
     
+    /** Goal-directed alternative to compute(): propagate until the
+	distances of the given target cell are known. Without
+	heuristic, it stops as soon as the target distance is final,
+	which saves guessing a ceiling when all you need is the
+	distance at e.g. the current robot position. With a heuristic,
+	it stops as soon as the target has been expanded, and the
+	result says that its distance is only an upper bound.
+	
+	With a positive heuristic weight, the front is ordered A*-style
+	by distance plus the weighted straight-line distance (at full
+	speed) to the target. That keeps the expansion from spreading
+	in directions that lead away from the target, which saves a lot
+	of work for point-to-point queries on large maps. The price is
+	accuracy: the upwind interpolation sees fewer expanded
+	neighbors along a narrow front, so the target distance comes
+	out higher than without heuristic. With a weight of 0.5, the
+	front covers about half the cells that a plain computeUntil()
+	expands, and the error stays around a tenth of a percent. A
+	weight of 1 cuts the expansions by another factor of four, but
+	the error then grows to five or ten percent. The corrections
+	that the heuristic held back are queued up, so calling
+	computeUntil() again without heuristic makes the target
+	distance final, and a later compute() gives the same result as
+	without heuristic.
+	
+	\note Like compute(), this can be called repeatedly and keeps
+	on propagating where it left off. A target whose distance is
+	already final returns immediately.
+	
+	\return REACHED_FINAL if the target distance is final,
+	REACHED_UPPER_BOUND if the target has been expanded with a
+	heuristic but could still get lowered by further propagation,
+	and UNREACHED (which is zero) if the target lies outside the
+	grid or cannot be reached (obstacle, or walled off from all
+	seeds). Also UNREACHED, without propagating anything, if the
+	heuristic weight is not between 0 and 1.
+    */
+    reach_t computeUntil(size_t ix, size_t iy,
+			 /** weight of the straight-line distance to
+			     the target in the queue keys, between 0
+			     (plain fast marching) and 1 */
+			 double heuristic = 0);
+    
+    /** Multi-target version of computeUntil(), which stops as soon
+	as the distances of all given cells (see index()) are final,
+	or with a heuristic as soon as they have all been
+	expanded. The heuristic uses the straight-line distance to the
+	closest target.
+	
+	\return The outcome for all targets together: UNREACHED if
+	some of them cannot be reached or if the heuristic weight is
+	out of range (in which case nothing is propagated),
+	REACHED_FINAL if all their distances are final, and
+	REACHED_UPPER_BOUND otherwise.
+    */
+    reach_t computeUntil(std::vector<size_t> const & targets,
+			 double heuristic = 0);
+    
+    /** Work-bounded alternative to compute(): expand at most the
+	given number of cells, then return. Like compute(), it picks
+	up where the previous call left off, so a long propagation can
+	be spread over several control cycles. Everything with a key
+	below the returned top_key is final.
+	
+	\return The number of expansions and the key at the top of the
+	queue, which is infinity once the propagation is complete.
+    */
+    progress_s computeFor(size_t max_expansions);
+    
+    /** Time-bounded version of computeFor(). The clock is only read
+	every few dozen expansions, so the call can overrun the given
+	budget by about as many expansions (some microseconds).
+	
+	\return See computeFor().
+    */
+    progress_s computeForTime(/** wall-clock budget in seconds */
+			      double max_seconds);
+    
+    /** Alternative to compute() based on the fast sweeping method:
+	instead of ordering the propagation with a queue, visit all
+	cells in four alternating raster orders (Gauss-Seidel sweeps)
+	and lower each of them using the same upwind interpolation as
+	compute(). This walks memory linearly and needs no queue, so
+	it can be much faster on large, mostly open maps. It needs
+	many more sweeps on maps where the distance has to wind its
+	way around obstacles, though, e.g. in mazes.
+	
+	Sweeping stops after four consecutive sweeps (one in each
+	order) in which no cell got lowered by more than the given
+	tolerance, or after max_sweeps sweeps, whichever comes
+	first. With a tolerance of zero, the result is the same as
+	that of compute(infinity) up to rounding.
+	
+	\note This uses the seeds (see setDist()) and any distances
+	that have already been computed, and it purges the queue and
+	the gradient cache. There is no ceiling: all reachable cells
+	get computed.
+	
+	\return The number of sweeps that were performed. If this
+	equals max_sweeps, the result has probably not converged.
+    */
+    size_t computeSweep(/** largest change in a cell's distance that
+			    is still considered as converged */
+			double tolerance,
+			/** upper limit on the number of sweeps */
+			size_t max_sweeps);
+    
+    /** Multi-threaded alternative to compute(). The grid is split
+	into square tiles of the given size, each of which runs its own
+	fast marching with its own queue on a private copy of the tile
+	plus a one-cell ghost ring holding the neighboring tiles'
+	border values. The computation proceeds in rounds: first, all
+	tiles compare their ghost rings with the current borders of
+	their neighbors, then all tiles that have seen a lower border
+	value (or that contain seeds) propagate until their local queue
+	is empty. Rounds are repeated until no border changes. Within
+	each phase, the tiles are handed out to the given number of
+	threads.
+	
+	The result is the same as that of compute(infinity) up to
+	rounding. Tiles of a few hundred cells on a side keep the
+	number of rounds low while still giving each thread enough
+	work, but on maps where the distance snakes back and forth
+	across tile borders, more rounds are needed.
+	
+	\note Like computeSweep(), this starts from the seeds and any
+	distances that have already been computed, it purges the queue
+	and the gradient cache, and there is no ceiling.
+	
+	\return The number of rounds that were performed.
+    */
+    size_t computeParallel(/** number of threads to use, including
+			       the calling one */
+			   size_t nthreads,
+			   /** number of cells along each side of a
+			       tile */
+			   size_t tilesize);
+    
+    /** Run compute(infinity) on each of the given transforms, handing
+	them out to the given number of threads. This is meant for
+	planning to many goals on the same costmap: create one
+	transform per goal on a shared speed map (see speedMap()), so
+	that each of them only stores its own distances, seed them,
+	then compute them all in one call.
+	
+	\note The transforms must be distinct objects, and none of
+	them may change its speeds during the call.
+    */
+    static void computeBatch(std::vector<BasicDistanceTransform*> const & batch,
+			     /** number of threads to use, including
+				 the calling one */
+			     size_t nthreads);
+    
+    /** Check whether the exact Euclidean engine applies: all cells
+	have the same (non-zero) speed, and all seeds have the same
+	distance. This is the case e.g. for a thresholded image
+	without speed map, as done by pngdtrans.
+	
+	\return True if computeEuclidean() can be used.
+    */
+    bool isUniform() const;
+    
+    /** Exact Euclidean distance transform for uniform maps (see
+	isUniform()), using the separable algorithm of Felzenszwalb and
+	Huttenlocher: a pass along each column followed by a lower
+	envelope of parabolas along each row. This takes linear
+	time and does not suffer from the approximation error of the
+	upwind interpolation used by compute(), which overestimates
+	distances along directions that are not aligned with the
+	grid. The results are thus slightly lower than those of
+	compute().
+	
+	\note Like computeSweep(), this purges the queue and the
+	gradient cache, and there is no ceiling. Distances that have
+	already been computed are simply overwritten.
+	
+	\return False (without touching anything) if the map is not
+	uniform or if there are no seeds.
+    */
+    bool computeEuclidean();
+    
     /** Reset all distance and gradient data and purge the queue, but
 	keep the speed map. This is useful if you want to use the
 	DistanceTransform as a global path planner and reuse a given
 	instance for planning to a new goal.
+	
+	\note The cost is proportional to the number of cells that
+	have been touched (seeded, expanded, or asked for their
+	gradient) since the last reset, not to the size of the
+	grid. So if you only ever compute() up to a small ceiling
+	around the goal, resetting is cheap as well. After the whole
+	grid engines (computeSweep(), computeParallel(),
+	computeEuclidean()), it resets the entire grid.
     */
     void resetDist();
     
@@ -170,6 +551,64 @@ namespace dtrans {
     */
     void resetSpeed();
     
+    /** Select the priority queue used for ordering the propagation
+	front. Cells that are already queued are carried over to the
+	new queue, so you can switch at any time.
+	
+	With BUCKET_QUEUE, keys are grouped into buckets of the given
+	width and cells within a bucket are expanded in the order they
+	arrived, not by key (untidy fast marching). Each cell is still
+	expanded only once: an expanded cell is frozen unless it would
+	drop by at least a bucket width, which only happens in repairs
+	after setSpeed(). The price is accuracy, the distances come out
+	higher than with EXACT_QUEUE. On uniform speeds the difference
+	vanishes, around obstacles it is up to about one bucket width,
+	and it creeps up slowly along long detours (a few widths on a
+	2000x2000 maze with a width equal to the scale). Buckets wider
+	than scale(), the smallest step between neighbors, would let
+	whole upwind chains share a bucket, so they are refused. Also,
+	getTopKey() and the ceiling of compute() are only accurate to
+	within one bucket width. A width of about half the scale is a
+	good starting point.
+	
+	\return False if the bucket width is not positive or larger
+	than scale() (in which case the policy is not changed).
+    */
+    bool setQueuePolicy(queue_policy_t policy, double bucket_width);
+    
+    /** \return The currently selected queue policy. */
+    inline queue_policy_t queuePolicy() const
+    { return m_bucketed ? BUCKET_QUEUE : EXACT_QUEUE; }
+    
+    /** Select the stencil used for computing the distance of a cell
+	from its neighbors. FIRST_ORDER interpolates between the best
+	neighbor along each axis, and its error shrinks linearly with
+	the cell size. SECOND_ORDER extrapolates from the best neighbor
+	and the next cell beyond it, as long as both have been
+	expanded already and the distance keeps decreasing, and falls
+	back to the first-order formula otherwise. Away from the seeds
+	and obstacle corners, the error then shrinks quadratically, so
+	the same accuracy can be reached with much coarser grids.
+	
+	Point sources are a singularity that limits any stencil to
+	first order in their vicinity. To get the full benefit, seed a
+	few cells around such a source with their exact distance, see
+	setDist().
+	
+	\note The incremental repair after setSpeed() assumes the
+	first-order stencil when tracking which cells depend on each
+	other. With SECOND_ORDER, the repaired field can differ from a
+	fresh computation by about the discretization error.
+	
+	\note This only affects distances that get computed after the
+	call, so you would normally select the stencil right after
+	construction.
+    */
+    inline void setStencil(stencil_t stencil) { m_second_order = (SECOND_ORDER == stencil); }
+    
+    /** \return The currently selected stencil. */
+    inline stencil_t stencil() const { return m_second_order ? SECOND_ORDER : FIRST_ORDER; }
+    
     /** Debugging version of compute(). It does the same propagation,
 	and writes information about what it is doing at each
 	iteration. */
@@ -199,6 +638,42 @@ namespace dtrans {
     size_t computeGradient(size_t ix, size_t iy,
 			   double & gx, double & gy) const;
     
+    /** Compute the unscaled upwind gradient for a rectangle of cells
+	in one go, with the same semantics as computeGradient(). The
+	results are written to caller-provided buffers which must have
+	room for nx*ny elements, stored row by row: the entry for cell
+	(ix, iy) goes to [(iy - y0) * nx + (ix - x0)]. This neither
+	allocates nor uses the gradient cache, and it is a lot faster
+	than calling computeGradient() for each cell, e.g. when you
+	need the entire gradient field for display or for following
+	paths from many starting points.
+	
+	\return False if the rectangle does not lie inside the grid
+	(in which case the buffers are not touched).
+    */
+    bool computeGradientField(/** X index of the lower left corner */
+			      size_t x0,
+			      /** Y index of the lower left corner */
+			      size_t y0,
+			      /** number of cells along X */
+			      size_t nx,
+			      /** number of cells along Y */
+			      size_t ny,
+			      /** receives the X component of the gradients */
+			      double * gx,
+			      /** receives the Y component of the gradients */
+			      double * gy,
+			      /** receives the number of neighbors that
+				  were taken into account, see
+				  computeGradient() */
+			      size_t * count) const;
+    
+    /** Convenience version of computeGradientField() for the entire
+	grid. The buffers must have room for nCells() elements, which
+	are stored in the same order as given by index(). */
+    inline void computeGradientField(double * gx, double * gy, size_t * count) const
+    { computeGradientField(0, 0, m_dimx, m_dimy, gx, gy, count); }
+    
     /** Perform one cell expansion. If the queue is empty, it does
 	nothing.
 	
@@ -246,38 +721,375 @@ namespace dtrans {
 	the given user-defined string. */
     void dumpQueue(FILE * fp, std::string const & prefix) const;
     
-    inline size_t const nCells() { return m_ncells; }
-    inline std::vector<double> const & valueArray() { return m_value; }
-    inline size_t index(size_t ix, size_t iy) const { return ix + m_dimx * iy; }
+    inline size_t const nCells() { return m_grid.nCells(); }
+    
+    /** Copy all distances into the given vector, which gets resized
+	to nCells(), in the same order as given by index(). Fixed
+	cells are negative, as in the internal storage. Passing the
+	same vector each time avoids reallocating it. */
+    void copyValues(std::vector<double> & values) const;
+    
+    /** Copy all labels into the given vector, like copyValues().
+	It ends up empty unless labels are in use, see setDist(). */
+    void copyLabels(std::vector<size_t> & labels) const;
+    
+    /** All distances at once, in the same order as given by
+	index(). This returns a fresh copy on each call, so it is safe
+	to call from several threads.
+	
+	\deprecated Use copyValues(), which can reuse its vector. */
+    inline std::vector<double> valueArray() const
+    { std::vector<double> values; copyValues(values); return values; }
+    
+    /** All labels at once, like valueArray(). Empty unless labels
+	are in use, see setDist().
+	
+	\deprecated Use copyLabels(), which can reuse its vector. */
+    inline std::vector<size_t> labelArray() const
+    { std::vector<size_t> labels; copyLabels(labels); return labels; }
+    
+    inline size_t index(size_t ix, size_t iy) const { return m_grid.index(ix, iy); }
     
   protected:
     typedef std::multimap<double, size_t> queue_t;
     typedef queue_t::iterator queue_it;
     typedef queue_t::const_iterator queue_cit;
     
+    GridIndex<2> const m_grid;	/**< the grid as seen through index() */
+    GridIndex<2> const m_slots;	/**< the grid plus its border, as stored */
+    
+    // Copies of what m_grid and m_slots know, for the inner loops
+    // which spell out the four neighbors by hand.
     size_t const m_dimx;
     size_t const m_dimy;
-    size_t const m_ncells;
-    size_t const m_toprow;
-    size_t const m_rightcol;
+    size_t const m_pitch;	/**< m_slots.stride(1), the offset between rows */
+    size_t const m_nslots;	/**< m_slots.nCells(), the size of all per-cell arrays */
     double const m_scale;
-    std::vector<double> m_value; /**< distance map, negative values mean "fixed cell" */
-    std::vector<double> m_lsm_radius; /**< scale/speed map, infinity means "obstacle" */
-    std::vector<double> m_lsm_r2; /**< square thereof, to speed up computations */
-    std::vector<double> m_key;	 /**< map of queue keys, a -1 means "not on queue" */
-    queue_t m_queue;
-    
-    // gradient map and its neighbor count, to support caching
-    mutable std::vector<double> m_gx;
-    mutable std::vector<double> m_gy;
+    
+    typedef CellField<Scalar, Cells::stride> field_t;
+    
+    std::vector<Scalar> m_store; /**< the fields below that live in the transform, see bindCells() */
+    field_t m_value;		 /**< distance map, negative values mean "fixed cell" */
+    field_t m_key;		 /**< map of queue keys, a -1 means "not on queue" */
+    field_t m_lsm_radius;	 /**< scale/speed map, infinity means "obstacle" */
+    speed_map_t * m_speed;	 /**< possibly shared, call ownSpeed() before writing */
+    Scalar * m_lsm_r2;		 /**< square of the radius in m_speed, see r2(), null for PackedCells */
+    std::vector<size_t> m_label; /**< source of each cell, empty unless labels are used */
+    DaryHeap<4> m_queue;	 /**< cells ordered by key, 4-ary for shallower sift-ups */
+    BucketQueue m_buckets;	 /**< alternative to m_queue when m_bucketed is set */
+    bool m_bucketed;
+    bool m_second_order;	 /**< see setStencil() */
+    
+    // gradient map and its neighbor count, to support caching (empty
+    // until the first gradient gets computed)
+    mutable std::vector<Scalar> m_gx;
+    mutable std::vector<Scalar> m_gy;
     mutable std::vector<int> m_gn;
+    mutable bool m_gn_used;	/**< set as soon as anything gets cached */
+    
+    /** Target coordinates for the A*-style heuristic of
+	computeUntil(), empty unless that is running. */
+    std::vector<double> m_goal_x;
+    std::vector<double> m_goal_y;
+    double m_goal_weight;
+    std::vector<size_t> m_deferred; /**< expanded cells that computeUntil() did not lower */
+    
+    /** Cells that resetDist() has to take care of: every cell whose
+	distance, key, or gradient differs from the initial state is
+	on this list, possibly more than once. */
+    mutable std::vector<size_t> m_touched;
+    mutable bool m_touched_all;	/**< the list got too long, or a whole-grid engine ran */
+    
+    /** \return The storage index of the cell at the given
+	coordinates.
+	\note Does not check the coordinates. */
+    inline size_t slot(size_t ix, size_t iy) const { return m_slots.index(ix + 1, iy + 1); }
+    
+    /** \return The storage index of a cell given by index().
+	\note Does not check the index. */
+    inline size_t slotOf(size_t index) const
+    { return index + m_pitch + 1 + 2 * (index / m_dimx); }
+    
+    /** Make the border fixed obstacles again, after the distances
+	have been overwritten wholesale. */
+    void initBorder();
+    
+    /** Point the fields at m_store (and at the speed map, for the
+	radius of SplitCells), after it has been allocated. */
+    void bindCells();
+    
+    /** \return The square of the LSM radius of a cell. */
+    inline Scalar r2(size_t index) const
+    { return Cells::packed ? m_lsm_radius[index] * m_lsm_radius[index] : m_lsm_r2[index]; }
+    
+    /** Write the LSM radius of a cell to the speed map, along with
+	its square for SplitCells, or to the speed map and the cell
+	record for PackedCells.
+	\note Call ownSpeed() first. */
+    inline void setRadius(size_t index, Scalar radius, Scalar r2)
+    {
+      if (Cells::packed) {
+	m_speed->m_radius[index] = radius;
+	m_lsm_radius[index] = radius;
+      }
+      else {
+	m_lsm_radius[index] = radius;
+	m_lsm_r2[index] = r2;
+      }
+    }
+    
+    /** Remember a cell that is about to be written for the first
+	time since the last reset. */
+    inline void touch(size_t index) const
+    {
+      if (m_touched_all) {
+	return;
+      }
+      if (m_touched.size() >= m_nslots / 8) {
+	// Beyond this, resetting the whole grid in one linear sweep
+	// is about as fast, and the list would take up too much
+	// memory.
+	m_touched_all = true;
+	m_touched.clear();
+	return;
+      }
+      m_touched.push_back(index);
+    }
 
+    inline bool queueEmpty() const
+    { return m_bucketed ? m_buckets.empty() : m_queue.empty(); }
+    
+    /** \note Does not check for an empty queue. */
+    inline double queueTopKey() const
+    { return m_bucketed ? m_buckets.topKey() : m_queue.topKey(); }
+    
+    inline bool queueContains(size_t index) const
+    { return m_bucketed ? m_buckets.contains(index) : m_queue.contains(index); }
+    
+    /** Switch to the given speed map, releasing the current one. */
+    void attachSpeed(speed_map_t * speed);
+    
+    /** Make a private copy of the speed map if it is shared, so that
+	it can be written to. */
+    void ownSpeed();
+    
     bool unqueue(size_t index);
     void requeue(size_t index);
+    
+    /** \return The queue key of a cell, i.e. its distance plus the
+	heuristic if computeUntil() has set one up. */
+    inline double keyOf(size_t index) const
+    {
+      double key(fabs(m_value[index]));
+      if ( ! m_goal_x.empty()) {
+	key += heuristic(index);
+      }
+      return key;
+    }
+    
+    /** \return The weighted straight-line distance at full speed
+	from a cell to the nearest target in m_goal_x and m_goal_y. */
+    double heuristic(size_t index) const;
+    
+    /** Recompute the keys of all queued cells, after the heuristic
+	has been switched on or off. */
+    void rekey();
+
+    /** Compute the distance of a (non-fixed, non-obstacle) cell from
+	the current values of its neighbors, without touching
+	anything.
+	
+	\return The candidate distance, or infinity if none of the
+	neighbors has a finite distance. */
+    Scalar solve(size_t index) const;
+    
+    /** Second-order version of solve(), see setStencil(). */
+    Scalar solve2(size_t index) const;
+    
+    /** Upwind term of the second-order stencil along one axis, given
+	the best neighbor n1 along that axis and the cell n2 beyond it
+	(which can be on the border). The squared difference
+	(u - center)^2 gets multiplied by the returned weight. */
+    inline Scalar upwind2(size_t n1, size_t n2, Scalar & center) const
+    {
+      Scalar const u1(fabs(m_value[n1]));
+      center = u1;
+      if ((m_key[n1] >= 0) || (m_key[n2] >= 0)) {
+	return 1;		// not yet expanded
+      }
+      Scalar const u2(fabs(m_value[n2]));
+      if (u2 > u1) {		// also catches obstacles and unreached cells
+	return 1;
+      }
+      center = (4 * u1 - u2) / 3;
+      return 2.25;
+    }
+    
     void update(size_t index);
     size_t pop();
+    
+    /** Update the four neighbors of a cell that has just been
+	popped from the queue. */
+    void expand(size_t index);
+    
+    /** Set the label of a cell to that of its primary propagator
+	(the neighbor with the lowest distance), right after the cell
+	got its distance. Does nothing unless labels are in use. */
+    inline void inheritLabel(size_t index)
+    {
+      if (m_label.empty()) {
+	return;
+      }
+      size_t best(index);
+      Scalar bestval(infinity);
+      if (fabs(m_value[index - m_pitch]) < bestval) {
+	best = index - m_pitch;
+	bestval = fabs(m_value[best]);
+      }
+      if (fabs(m_value[index + m_pitch]) < bestval) {
+	best = index + m_pitch;
+	bestval = fabs(m_value[best]);
+      }
+      if (fabs(m_value[index - 1]) < bestval) {
+	best = index - 1;
+	bestval = fabs(m_value[best]);
+      }
+      if (fabs(m_value[index + 1]) < bestval) {
+	best = index + 1;
+      }
+      m_label[index] = (best == index) ? nolabel : m_label[best];
+    }
+    
+    /** Forget the cached gradients that depend on the distance of
+	the given cell, i.e. those of the cell and of its four
+	neighbors. */
+    void invalidateGradient(size_t index);
+    
+    /** \return The distance of the best propagator along Y, or
+	infinity if there is none. */
+    inline Scalar nsMin(size_t index) const
+    {
+      Scalar const south(fabs(m_value[index - m_pitch]));
+      Scalar const north(fabs(m_value[index + m_pitch]));
+      return south < north ? south : north;
+    }
+    
+    /** \return The distance of the best propagator along X, or
+	infinity if there is none. */
+    inline Scalar ewMin(size_t index) const
+    {
+      Scalar const west(fabs(m_value[index - 1]));
+      Scalar const east(fabs(m_value[index + 1]));
+      return west < east ? west : east;
+    }
+    
+    /** Add a neighbor to the region of a raise() if it lies downwind
+	of the invalidated cell, i.e. if that cell (with its old
+	distance vc) is the best propagator along their common axis
+	and actually contributes to the neighbor's distance. The other
+	cell along the same axis (vother) keeps the neighbor valid if
+	it is at least as low, and the best propagator along the cross
+	axis (vcross) makes the cell irrelevant if the interpolation
+	does not use it. */
+    void collect(size_t nn, Scalar vc, Scalar vother, Scalar vcross,
+		 std::vector<size_t> & region, std::vector<Scalar> & old);
+    
+    /** Second-order counterpart of collect(): add the cells two steps
+	away from a region cell cc (at ix, iy with old distance vc)
+	whose stencil reaches over the cell in between to use cc. */
+    void collect2(size_t cc, size_t ix, size_t iy, Scalar vc,
+		  std::vector<size_t> & region, std::vector<Scalar> & old);
+    
+    /** Set the LSM radius of a cell and take care of any repairs
+	after propagation, see setSpeed(). The square of the radius is
+	passed along so that bulk setters can precompute it. */
+    inline void storeRadius(size_t index, Scalar radius, Scalar r2)
+    {
+      if (m_value[index] >= infinity) { // not reached yet, nothing to repair
+	setRadius(index, radius, r2);
+	return;
+      }
+      Scalar const oldradius(m_lsm_radius[index]);
+      setRadius(index, radius, r2);
+      if (radius > oldradius) {
+	raise(index);
+      }
+      else if (radius < oldradius) {
+	lower(index);
+      }
+    }
+    
+    /** \return A distance given through the interface as Scalar,
+	where anything beyond the range of Scalar becomes infinity. */
+    static inline Scalar narrow(double dist)
+    { return dist < infinity ? static_cast<Scalar>(dist) : infinity; }
+    
+    /** Mark a cell as seed for the bulk setters. New heap entries are
+	only appended, and cells that were already on the heap go to
+	the pending list, see finishSeeds(). */
+    void storeSeed(size_t index, Scalar dist, std::vector<size_t> & pending);
+    
+    /** Restore the heap after storeSeed(), given its size before the
+	first call, and update the keys of pending cells. */
+    void finishSeeds(size_t oldsize, std::vector<size_t> const & pending);
+    
+    /** Repair after the speed of a cell went down (its LSM radius
+	went up): reset the cell and everything downwind of it to
+	infinity, then queue the ones that can be reached from the
+	remaining cells. */
+    void raise(size_t index);
+    
+    /** Repair after the speed of a cell went up: lower its distance
+	(if possible) and queue it. */
+    void lower(size_t index);
+    
+    /** One fast sweeping pass in the given X and Y directions. Keeps
+	track of the largest change in maxchange.
+	
+	\return The number of cells that got lowered. */
+    size_t sweep(bool xup, bool yup, Scalar & maxchange);
+    
+    /** Bookkeeping for one tile of computeParallel(), see
+	DistanceTransform.cpp */
+    struct tile_s;
+    
+    /** Per-thread state of computeParallel(), see
+	DistanceTransform.cpp */
+    struct worker_s;
+    
+    /** Compare the ghost ring of a tile with the current borders of
+	its neighbors and remember which ghost cells got lower. Only
+	reads m_value, so it can run on all tiles concurrently. */
+    void scanTile(tile_s & tile) const;
+    
+    /** Run fast marching on a tile, using the given scratch
+	transform (which must be large enough to hold the tile plus
+	its ghost ring). Only writes the cells of the given tile, so
+	it can run on all tiles concurrently. */
+    void runTile(tile_s & tile, BasicDistanceTransform & scratch);
+    
+    /** Thread entry point for computeParallel(). */
+    static void * parallelWorker(void * arg);
+    
+    /** Run parallelWorker() in as many threads as there are workers
+	(the first one in the calling thread) and wait for them to
+	finish. */
+    static void runWorkers(std::vector<worker_s> & worker, bool scan);
+    
+  private:
+    BasicDistanceTransform & operator = (BasicDistanceTransform const &);
   };
   
+  
+  /** Distance transform with one array per quantity, see SplitCells. */
+  typedef BasicDistanceTransform<double, SplitCells> DistanceTransform;
+  
+  /** Distance transform with one record per cell, see PackedCells. */
+  typedef BasicDistanceTransform<double, PackedCells> PackedDistanceTransform;
+  
+  /** Single-precision version of DistanceTransform. */
+  typedef BasicDistanceTransform<float, SplitCells> FloatDistanceTransform;
+  
 }
 
 #endif // DTRANS_DISTANCE_TRANSFORM_HPP
@@ -0,0 +1,359 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DistanceTransform3D.hpp"
+#include <limits>
+#include <algorithm>
+#include <math.h>
+
+
+namespace dtrans {
+  
+  double const DistanceTransform3D::infinity(std::numeric_limits<double>::max());
+  double const DistanceTransform3D::epsilon(1e-6);
+  
+  
+  DistanceTransform3D::
+  DistanceTransform3D(size_t dimx, size_t dimy, size_t dimz, double scale)
+    : m_grid(dimx, dimy, dimz),
+      m_scale(scale),
+      m_value(m_grid.nCells(), infinity),
+      m_radius(m_grid.nCells(), scale),
+      m_queue(m_grid.nCells())
+  {
+  }
+  
+  
+  bool DistanceTransform3D::
+  setDist(size_t ix, size_t iy, size_t iz, double dist)
+  {
+    if ((dist < 0) || ! isValid(ix, iy, iz)) {
+      return false;
+    }
+    size_t const cell(index(ix, iy, iz));
+    m_value[cell] = -dist;	// <=0 means "fixed"
+    m_queue.set(cell, dist);
+    return true;
+  }
+  
+  
+  bool DistanceTransform3D::
+  setSpeed(size_t ix, size_t iy, size_t iz, double speed)
+  {
+    if ((speed < 0) || (speed > 1) || ! isValid(ix, iy, iz)) {
+      return false;
+    }
+    
+    size_t const cell(index(ix, iy, iz));
+    double const radius((speed < epsilon) ? infinity : m_scale / speed);
+    double const oldradius(m_radius[cell]);
+    m_radius[cell] = radius;
+    if (m_value[cell] >= infinity) { // not reached yet, nothing to repair
+      return true;
+    }
+    if (radius > oldradius) {
+      raise(cell);
+    }
+    else if (radius < oldradius) {
+      lower(cell);
+    }
+    return true;
+  }
+  
+  
+  double DistanceTransform3D::
+  getDist(size_t ix, size_t iy, size_t iz) const
+  {
+    if ( ! isValid(ix, iy, iz)) {
+      return infinity;
+    }
+    return fabs(m_value[index(ix, iy, iz)]);
+  }
+  
+  
+  void DistanceTransform3D::
+  compute(double ceiling)
+  {
+    while ( ! m_queue.empty()) {
+      if (m_queue.topKey() > ceiling) {
+	break;
+      }
+      propagate();
+    }
+  }
+  
+  
+  bool DistanceTransform3D::
+  propagate()
+  {
+    if (m_queue.empty()) {
+      return false;
+    }
+    size_t const index(m_queue.pop());
+    size_t coord[3];
+    m_grid.coords(index, coord);
+    // Neighbor coordinates differ from ours along one axis only, so
+    // step that one back and forth instead of recomputing them.
+    for (size_t axis(0); axis < 3; ++axis) {
+      if (m_grid.hasLower(index, coord, axis)) {
+	--coord[axis];
+	update(index - m_grid.stride(axis), coord);
+	++coord[axis];
+      }
+      if (m_grid.hasUpper(index, coord, axis)) {
+	++coord[axis];
+	update(index + m_grid.stride(axis), coord);
+	--coord[axis];
+      }
+    }
+    return true;
+  }
+  
+  
+  double DistanceTransform3D::
+  getTopKey() const
+  {
+    if (m_queue.empty()) {
+      return infinity;
+    }
+    return m_queue.topKey();
+  }
+  
+  
+  void DistanceTransform3D::
+  axisMin(size_t index, size_t const * coord, double * vmin) const
+  {
+    for (size_t axis(0); axis < 3; ++axis) {
+      size_t const stride(m_grid.stride(axis));
+      vmin[axis] = infinity;
+      if (m_grid.hasLower(index, coord, axis)) {
+	vmin[axis] = fabs(m_value[index - stride]);
+      }
+      if (m_grid.hasUpper(index, coord, axis)) {
+	double const nval(fabs(m_value[index + stride]));
+	if (nval < vmin[axis]) {
+	  vmin[axis] = nval;
+	}
+      }
+    }
+  }
+  
+  
+  double DistanceTransform3D::
+  solve(size_t index, size_t const * coord) const
+  {
+    double vv[3];
+    axisMin(index, coord, vv);
+    if (vv[0] > vv[1]) {
+      std::swap(vv[0], vv[1]);
+    }
+    if (vv[1] > vv[2]) {
+      std::swap(vv[1], vv[2]);
+    }
+    if (vv[0] > vv[1]) {
+      std::swap(vv[0], vv[1]);
+    }
+    if (vv[0] >= infinity) {
+      return infinity;
+    }
+    
+    // Add axes in order of increasing neighbor value for as long as
+    // the solution lies above the next one. Each step solves
+    // sum_i (u - vv[i])^2 = radius^2 over the axes used so far. An
+    // axis at infinity never lies below the solution.
+    double const radius(m_radius[index]);
+    double uu(vv[0] + radius);
+    if (uu <= vv[1]) {
+      return uu;
+    }
+    double const r2(radius * radius);
+    double const d01(vv[1] - vv[0]);
+    uu = (vv[0] + vv[1] + sqrt(2.0 * r2 - d01 * d01)) / 2.0;
+    if (uu <= vv[2]) {
+      return uu;
+    }
+    double const bb(vv[0] + vv[1] + vv[2]);
+    double const cc(vv[0] * vv[0] + vv[1] * vv[1] + vv[2] * vv[2] - r2);
+    double const root(bb * bb - 3.0 * cc);
+    return (bb + sqrt(root > 0 ? root : 0)) / 3.0;
+  }
+  
+  
+  void DistanceTransform3D::
+  update(size_t index, size_t const * coord)
+  {
+    if (m_value[index] <= 0) {	// fixed cell, skip it
+      return;
+    }
+    if (m_radius[index] >= infinity) { // obstacle, it'll always be at infinity
+      m_value[index] = -infinity;
+      return;
+    }
+    double const rhs(solve(index, coord));
+    if (rhs < m_value[index]) {
+      m_value[index] = rhs;
+      m_queue.set(index, rhs);
+    }
+  }
+  
+  
+  void DistanceTransform3D::
+  raise(size_t index)
+  {
+    double const value(m_value[index]);
+    if ((value <= 0) || (value >= infinity)) {
+      return;
+    }
+    
+    // Invalidate the cell and everything downwind of it, as in
+    // DistanceTransform::raise(). A neighbor depends on a region
+    // cell if it lies above it (the upwind solution only uses axes
+    // below itself) and the region cell was the lower of its two
+    // neighbors along that axis.
+    std::vector<size_t> region(1, index);
+    std::vector<double> old(1, value);
+    m_value[index] = infinity;
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      double const vc(old[ir]);
+      size_t coord[3];
+      m_grid.coords(cc, coord);
+      for (size_t axis(0); axis < 3; ++axis) {
+	size_t const stride(m_grid.stride(axis));
+	size_t const last(m_grid.last(axis));
+	for (int dir(-1); dir <= 1; dir += 2) {
+	  if ((dir < 0) ? (coord[axis] < 1) : (coord[axis] + 1 > last)) {
+	    continue;
+	  }
+	  size_t const nn(dir < 0 ? cc - stride : cc + stride);
+	  double const vn(m_value[nn]);
+	  if ((vn <= vc) || (vn >= infinity)) {
+	    continue;
+	  }
+	  bool const beyond((dir < 0) ? (coord[axis] >= 2) : (coord[axis] + 2 <= last));
+	  if (beyond && (fabs(m_value[dir < 0 ? nn - stride : nn + stride]) <= vc)) {
+	    continue;
+	  }
+	  region.push_back(nn);
+	  old.push_back(vn);
+	  m_value[nn] = infinity;
+	}
+      }
+    }
+    
+    // Queue the rim of the region with what it gets from outside.
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      m_queue.remove(cc);
+      if (m_radius[cc] >= infinity) {
+	old[ir] = -infinity;
+      }
+      else {
+	size_t coord[3];
+	m_grid.coords(cc, coord);
+	old[ir] = solve(cc, coord);
+      }
+    }
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      m_value[cc] = old[ir];
+      if ((old[ir] > 0) && (old[ir] < infinity)) {
+	m_queue.set(cc, old[ir]);
+      }
+    }
+  }
+  
+  
+  void DistanceTransform3D::
+  lower(size_t index)
+  {
+    double const value(m_value[index]);
+    if (value <= -infinity) {	// obstacle that has become free space
+      m_value[index] = infinity;
+    }
+    else if (value <= 0) {	// seed, does not depend on its speed
+      return;
+    }
+    size_t coord[3];
+    m_grid.coords(index, coord);
+    double const rhs(solve(index, coord));
+    if (rhs < m_value[index]) {
+      m_value[index] = rhs;
+      m_queue.set(index, rhs);
+    }
+  }
+  
+  
+  size_t DistanceTransform3D::
+  computeGradient(size_t ix, size_t iy, size_t iz,
+		  double & gx, double & gy, double & gz) const
+  {
+    double grad[3] = { 0, 0, 0 };
+    size_t count(0);
+    if (isValid(ix, iy, iz)) {
+      size_t const coord[3] = { ix, iy, iz };
+      size_t const cell(index(ix, iy, iz));
+      double const height(fabs(m_value[cell]));
+      // same rules as in DistanceTransform::computeGradient()
+      for (size_t axis(0); axis < 3; ++axis) {
+	size_t const stride(m_grid.stride(axis));
+	double const below(m_grid.hasLower(cell, coord, axis)
+			   ? fabs(m_value[cell - stride]) : height);
+	double const above(m_grid.hasUpper(cell, coord, axis)
+			   ? fabs(m_value[cell + stride]) : height);
+	if ((below < height) || (above < height)) {
+	  ++count;
+	  grad[axis] = (below <= above) ? height - below : above - height;
+	}
+      }
+    }
+    gx = grad[0];
+    gy = grad[1];
+    gz = grad[2];
+    return count;
+  }
+  
+  
+  void DistanceTransform3D::
+  resetDist()
+  {
+    m_queue.clear();
+    m_value.assign(m_grid.nCells(), infinity);
+  }
+  
+  
+  void DistanceTransform3D::
+  resetSpeed()
+  {
+    m_radius.assign(m_grid.nCells(), m_scale);
+  }
+  
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DTRANS_DISTANCE_TRANSFORM_3D_HPP
+#define DTRANS_DISTANCE_TRANSFORM_3D_HPP
+
+#include "IndexedHeap.hpp"
+#include "GridIndex.hpp"
+#include <vector>
+#include <stddef.h>
+
+
+namespace dtrans {
+  
+  
+  /**
+     Distance transform on a three-dimensional voxel grid, e.g. an
+     occupancy grid for flying robots. It works like
+     DistanceTransform, but each cell has six face neighbors and the
+     upwind update solves a quadratic along up to three axes. The
+     API is the same as far as it goes: seeds via setDist(),
+     obstacles and slow cells via setSpeed() (which can also be
+     changed after propagating), compute() or propagate(), and
+     upwind gradients.
+     
+     The alternative queues, the parallel and sweeping engines, labels
+     and the second-order stencil of DistanceTransform are not
+     available here. In exchange, a voxel takes 24 bytes (distance,
+     LSM radius, and heap slot) instead of about 60.
+  */
+  class DistanceTransform3D
+  {
+  public:
+    /** Same as DistanceTransform::infinity. */
+    static double const infinity;
+    
+    /** Same as DistanceTransform::epsilon. */
+    static double const epsilon;
+    
+    DistanceTransform3D(/** number of cells along X */
+			size_t dimx,
+			/** number of cells along Y */
+			size_t dimy,
+			/** number of cells along Z */
+			size_t dimz,
+			/** length of the side of one cell */
+			double scale);
+    
+    inline bool isValid(size_t ix, size_t iy, size_t iz) const
+    { return m_grid.isValid(ix, iy, iz); }
+    
+    inline size_t dimX() const { return m_grid.dim(0); }
+    inline size_t dimY() const { return m_grid.dim(1); }
+    inline size_t dimZ() const { return m_grid.dim(2); }
+    inline double scale() const { return m_scale;}
+    inline size_t nCells() const { return m_grid.nCells(); }
+    inline size_t index(size_t ix, size_t iy, size_t iz) const { return m_grid.index(ix, iy, iz); }
+    inline std::vector<double> const & valueArray() const { return m_value; }
+    
+    /** Set a given cell to a fixed distance, see
+	DistanceTransform::setDist().
+	
+	\return True if the cell's distance value has been set
+	(i.e. the given coordinates lie within the grid). */
+    bool setDist(size_t ix, size_t iy, size_t iz, double dist);
+    
+    /** Set the propagation speed of a cell, normalized to [0, 1]
+	where zero means obstacle. Like in DistanceTransform::setSpeed(),
+	changing the speed after propagating puts the affected cells
+	back on the queue, and the next compute() repairs them.
+	
+	\return False if the speed is out of range or the cell lies
+	outside the grid. */
+    bool setSpeed(size_t ix, size_t iy, size_t iz, double speed);
+    
+    /** \return The distance of a cell, or DistanceTransform::infinity
+	if it lies outside the grid or has not been reached. */
+    double getDist(size_t ix, size_t iy, size_t iz) const;
+    
+    /** Propagate until the top of the queue lies above the given
+	ceiling or the queue is empty, see
+	DistanceTransform::compute(). */
+    void compute(double ceiling);
+    
+    /** Expand the cell at the top of the queue.
+	
+	\return False if there was nothing left to do. */
+    bool propagate();
+    
+    /** \return The key at the top of the queue, or
+	DistanceTransform::infinity if it is empty. */
+    double getTopKey() const;
+    
+    /** Compute the unscaled upwind gradient at a cell, with the same
+	semantics as DistanceTransform::computeGradient() except that
+	nothing gets cached.
+	
+	\return The number of axes that contributed to the gradient,
+	zero if the cell is invalid. */
+    size_t computeGradient(size_t ix, size_t iy, size_t iz,
+			   double & gx, double & gy, double & gz) const;
+    
+    /** Put all cells back to infinity and clear the queue, but keep
+	the speeds. */
+    void resetDist();
+    
+    /** Put all cells back to unit speed. */
+    void resetSpeed();
+    
+  protected:
+    GridIndex<3> const m_grid;
+    double const m_scale;
+    std::vector<double> m_value; /**< distance map, negative values mean "fixed cell" */
+    std::vector<double> m_radius; /**< scale/speed, infinity means "obstacle" */
+    IndexedHeap m_queue;	  /**< doubles as the "is queued" flag */
+    
+    /** Store the smallest neighbor value along each axis in vmin,
+	with infinity for missing neighbors. */
+    void axisMin(size_t index, size_t const * coord, double * vmin) const;
+    
+    /** Upwind update of a cell from its six neighbors, by solving
+	the quadratic along the one, two, or three axes whose lowest
+	neighbor lies below the result. The coordinates are passed
+	along to avoid recomputing them. */
+    double solve(size_t index, size_t const * coord) const;
+    
+    /** Lower a cell to the result of solve() and queue it, unless it
+	is fixed or an obstacle. The coordinates are those of the
+	cell, as for solve(). */
+    void update(size_t index, size_t const * coord);
+    
+    /** Repair after the LSM radius of a reached cell went up, see
+	DistanceTransform::raise(). */
+    void raise(size_t index);
+    
+    /** Repair after the LSM radius of a reached cell went down. */
+    void lower(size_t index);
+  };
+  
+}
+
+#endif // DTRANS_DISTANCE_TRANSFORM_3D_HPP
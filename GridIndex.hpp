@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DTRANS_GRID_INDEX_HPP
+#define DTRANS_GRID_INDEX_HPP
+
+#include <stddef.h>
+
+
+namespace dtrans {
+  
+  
+  /**
+     Mapping between N-dimensional cell coordinates and linear cell
+     indices, with the X axis varying fastest. This also holds the
+     boundary tests that the distance transforms use to find the face
+     neighbors of a cell: along the X axis (and the middle axes) they
+     compare the cell's coordinate, along the slowest axis they
+     compare the linear index against the first and last slab, which
+     needs no division.
+     
+     The dimension is a template parameter so that all loops over
+     axes get unrolled, and index(ix, iy) is just as cheap as the
+     hand-written ix + dimx * iy it replaces.
+  */
+  template<size_t N>
+  class GridIndex
+  {
+  public:
+    explicit GridIndex(/** N dimensions, the X axis comes first */
+		       size_t const * dim)
+    {
+      init(dim);
+    }
+    
+    /** Convenience constructor for N == 2. */
+    GridIndex(size_t dimx, size_t dimy)
+    {
+      (void) sizeof(char[(N == 2) ? 1 : -1]);
+      size_t const dim[] = { dimx, dimy };
+      init(dim);
+    }
+    
+    /** Convenience constructor for N == 3. */
+    GridIndex(size_t dimx, size_t dimy, size_t dimz)
+    {
+      (void) sizeof(char[(N == 3) ? 1 : -1]);
+      size_t const dim[] = { dimx, dimy, dimz };
+      init(dim);
+    }
+    
+    inline size_t dim(size_t axis) const { return m_dim[axis]; }
+    
+    /** \return The index offset between neighbors along the given axis. */
+    inline size_t stride(size_t axis) const { return m_stride[axis]; }
+    
+    inline size_t nCells() const { return m_ncells; }
+    
+    /** \return The first index of the last slab along the slowest
+	axis. Cells at or beyond it have no upper neighbor along that
+	axis (in 2D, this is the top row). */
+    inline size_t lastSlab() const { return m_lastslab; }
+    
+    /** \return The highest coordinate along the given axis. Cells
+	there have no upper neighbor along that axis (in 2D along X,
+	this is the right column). */
+    inline size_t last(size_t axis) const { return m_dim[axis] - 1; }
+    
+    inline bool isValid(size_t const * coord) const
+    {
+      for (size_t axis(0); axis < N; ++axis) {
+	if (coord[axis] >= m_dim[axis]) {
+	  return false;
+	}
+      }
+      return true;
+    }
+    
+    inline bool isValid(size_t ix, size_t iy) const
+    { return (ix < m_dim[0]) && (iy < m_dim[1]); }
+    
+    inline bool isValid(size_t ix, size_t iy, size_t iz) const
+    { return (ix < m_dim[0]) && (iy < m_dim[1]) && (iz < m_dim[2]); }
+    
+    /** \note Does not check the coordinates, see isValid(). */
+    inline size_t index(size_t const * coord) const
+    {
+      size_t index(coord[0]);
+      for (size_t axis(1); axis < N; ++axis) {
+	index += m_stride[axis] * coord[axis];
+      }
+      return index;
+    }
+    
+    inline size_t index(size_t ix, size_t iy) const
+    { return ix + m_stride[1] * iy; }
+    
+    inline size_t index(size_t ix, size_t iy, size_t iz) const
+    { return ix + m_stride[1] * iy + m_stride[2] * iz; }
+    
+    /** Inverse of index().
+	
+	\note Does not check the index. */
+    inline void coords(size_t index, size_t * coord) const
+    {
+      for (size_t axis(0); axis + 1 < N; ++axis) {
+	coord[axis] = index % m_dim[axis];
+	index /= m_dim[axis];
+      }
+      coord[N - 1] = index;
+    }
+    
+    /** \return True if the cell has a neighbor below it along the
+	given axis. The coordinates must match the index, but the one
+	along the slowest axis is not used. */
+    inline bool hasLower(size_t index, size_t const * coord, size_t axis) const
+    {
+      if (N - 1 == axis) {
+	return index >= m_stride[N - 1];
+      }
+      return coord[axis] > 0;
+    }
+    
+    /** \return True if the cell has a neighbor above it along the
+	given axis, see hasLower(). */
+    inline bool hasUpper(size_t index, size_t const * coord, size_t axis) const
+    {
+      if (N - 1 == axis) {
+	return index < m_lastslab;
+      }
+      return coord[axis] < m_dim[axis] - 1;
+    }
+    
+  protected:
+    size_t m_dim[N];
+    size_t m_stride[N];
+    size_t m_ncells;
+    size_t m_lastslab;
+    
+    void init(size_t const * dim)
+    {
+      m_ncells = 1;
+      for (size_t axis(0); axis < N; ++axis) {
+	m_dim[axis] = dim[axis];
+	m_stride[axis] = m_ncells;
+	m_ncells *= dim[axis];
+      }
+      m_lastslab = m_ncells - m_stride[N - 1];
+    }
+  };
+  
+}
+
+#endif // DTRANS_GRID_INDEX_HPP
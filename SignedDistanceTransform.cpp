@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SignedDistanceTransform.hpp"
+#include <limits>
+#include <math.h>
+
+
+namespace dtrans {
+  
+  double const SignedDistanceTransform::infinity(std::numeric_limits<double>::max());
+  double const SignedDistanceTransform::epsilon(1e-6);
+  
+  
+  SignedDistanceTransform::
+  SignedDistanceTransform(size_t dimx, size_t dimy, double scale)
+    : m_grid(dimx, dimy),
+      m_dimx(dimx),
+      m_toprow(m_grid.lastSlab()),
+      m_rightcol(m_grid.last(0)),
+      m_scale(scale),
+      m_value(m_grid.nCells(), infinity),
+      m_flags(m_grid.nCells(), 0),
+      m_radius(m_grid.nCells(), scale),
+      m_queue(m_grid.nCells())
+  {
+  }
+  
+  
+  bool SignedDistanceTransform::
+  setInside(size_t ix, size_t iy, bool inside)
+  {
+    if ( ! isValid(ix, iy)) {
+      return false;
+    }
+    size_t const cell(index(ix, iy));
+    m_queue.remove(cell);
+    m_flags[cell] = inside ? INSIDE : 0;
+    m_value[cell] = inside ? -infinity : infinity;
+    return true;
+  }
+  
+  
+  bool SignedDistanceTransform::
+  isInside(size_t ix, size_t iy) const
+  {
+    return isValid(ix, iy) && (m_flags[index(ix, iy)] & INSIDE);
+  }
+  
+  
+  bool SignedDistanceTransform::
+  setDist(size_t ix, size_t iy, double dist)
+  {
+    if ( ! isValid(ix, iy)) {
+      return false;
+    }
+    size_t const cell(index(ix, iy));
+    if (dist < 0) {
+      m_flags[cell] |= INSIDE;
+    }
+    else if (dist > 0) {
+      m_flags[cell] &= ~INSIDE;
+    }
+    m_flags[cell] |= FIXED;
+    m_value[cell] = dist;
+    m_queue.set(cell, fabs(dist));
+    return true;
+  }
+  
+  
+  size_t SignedDistanceTransform::
+  seedBoundary()
+  {
+    // Collect first, so that seeding a cell does not change what its
+    // neighbors see.
+    std::vector<size_t> boundary;
+    size_t const ncells(m_grid.nCells());
+    for (size_t index(0); index < ncells; ++index) {
+      if (m_flags[index] & FIXED) {
+	continue;
+      }
+      unsigned char const side(m_flags[index] & INSIDE);
+      size_t const ix(index % m_dimx);
+      if (((index >= m_dimx) && (side != (m_flags[index - m_dimx] & INSIDE)))
+	  || ((index < m_toprow) && (side != (m_flags[index + m_dimx] & INSIDE)))
+	  || ((ix > 0) && (side != (m_flags[index - 1] & INSIDE)))
+	  || ((ix < m_rightcol) && (side != (m_flags[index + 1] & INSIDE)))) {
+	boundary.push_back(index);
+      }
+    }
+    double const half(m_scale / 2);
+    for (size_t ii(0); ii < boundary.size(); ++ii) {
+      size_t const cell(boundary[ii]);
+      m_flags[cell] |= FIXED;
+      m_value[cell] = (m_flags[cell] & INSIDE) ? -half : half;
+      m_queue.set(cell, half);
+    }
+    return boundary.size();
+  }
+  
+  
+  bool SignedDistanceTransform::
+  setSpeed(size_t ix, size_t iy, double speed)
+  {
+    if ((speed < 0) || (speed > 1) || ! isValid(ix, iy)) {
+      return false;
+    }
+    m_radius[index(ix, iy)] = (speed < epsilon) ? infinity : m_scale / speed;
+    return true;
+  }
+  
+  
+  double SignedDistanceTransform::
+  getDist(size_t ix, size_t iy) const
+  {
+    if ( ! isValid(ix, iy)) {
+      return infinity;
+    }
+    return m_value[index(ix, iy)];
+  }
+  
+  
+  void SignedDistanceTransform::
+  compute(double range)
+  {
+    while ( ! m_queue.empty()) {
+      if (m_queue.topKey() > range) {
+	break;
+      }
+      propagate();
+    }
+  }
+  
+  
+  bool SignedDistanceTransform::
+  propagate()
+  {
+    if (m_queue.empty()) {
+      return false;
+    }
+    size_t const index(m_queue.pop());
+    if (index >= m_dimx) {	// south
+      update(index - m_dimx);
+    }
+    if (index < m_toprow) {	// north
+      update(index + m_dimx);
+    }
+    size_t const ix(index % m_dimx);
+    if (ix > 0) {		// west
+      update(index - 1);
+    }
+    if (ix < m_rightcol) {	// east
+      update(index + 1);
+    }
+    return true;
+  }
+  
+  
+  double SignedDistanceTransform::
+  getTopKey() const
+  {
+    if (m_queue.empty()) {
+      return infinity;
+    }
+    return m_queue.topKey();
+  }
+  
+  
+  void SignedDistanceTransform::
+  update(size_t index)
+  {
+    unsigned char const flags(m_flags[index]);
+    if ((flags & FIXED) || (m_radius[index] >= infinity)) {
+      return;
+    }
+    
+    // Same as the first-order DistanceTransform::solve(), on the
+    // magnitudes of the neighbors on our side.
+    unsigned char const side(flags & INSIDE);
+    double ns(infinity);
+    if (index >= m_dimx) {
+      ns = sideDist(index - m_dimx, side);
+    }
+    if (index < m_toprow) {
+      double const nval(sideDist(index + m_dimx, side));
+      if (nval < ns) {
+	ns = nval;
+      }
+    }
+    size_t const ix(index % m_dimx);
+    double ew(infinity);
+    if (ix > 0) {
+      ew = sideDist(index - 1, side);
+    }
+    if (ix < m_rightcol) {
+      double const nval(sideDist(index + 1, side));
+      if (nval < ew) {
+	ew = nval;
+      }
+    }
+    double primary(ns);
+    double secondary(ew);
+    if (secondary < primary) {
+      primary = ew;
+      secondary = ns;
+    }
+    if (primary >= infinity) {
+      return;
+    }
+    
+    double const radius(m_radius[index]);
+    double rhs(primary + radius);
+    if (radius > secondary - primary) {
+      double const dd(secondary - primary);
+      rhs = primary + (dd + sqrt(2 * radius * radius - dd * dd)) / 2;
+    }
+    if (rhs < fabs(m_value[index])) {
+      m_value[index] = side ? -rhs : rhs;
+      m_queue.set(index, rhs);
+    }
+  }
+  
+  
+  size_t SignedDistanceTransform::
+  computeGradient(size_t ix, size_t iy,
+		  double & gx, double & gy) const
+  {
+    gx = 0;
+    gy = 0;
+    if ( ! isValid(ix, iy)) {
+      return 0;
+    }
+    
+    // Same rules as in DistanceTransform::computeGradient(), with
+    // neighbors on the other side counting as missing.
+    size_t const cell(index(ix, iy));
+    unsigned char const side(m_flags[cell] & INSIDE);
+    double const height(fabs(m_value[cell]));
+    double const south(iy > 0 ? sideDist(cell - m_dimx, side) : height);
+    double const north(cell < m_toprow ? sideDist(cell + m_dimx, side) : height);
+    double const west(ix > 0 ? sideDist(cell - 1, side) : height);
+    double const east(ix < m_rightcol ? sideDist(cell + 1, side) : height);
+    size_t count(0);
+    if ((south < height) || (north < height)) {
+      ++count;
+      gy = (south <= north) ? height - south : north - height;
+    }
+    if ((west < height) || (east < height)) {
+      ++count;
+      gx = (west <= east) ? height - west : east - height;
+    }
+    if (side) {
+      gx = -gx;
+      gy = -gy;
+    }
+    return count;
+  }
+  
+  
+  void SignedDistanceTransform::
+  resetDist()
+  {
+    m_queue.clear();
+    size_t const ncells(m_grid.nCells());
+    for (size_t ii(0); ii < ncells; ++ii) {
+      m_flags[ii] &= ~FIXED;
+      m_value[ii] = (m_flags[ii] & INSIDE) ? -infinity : infinity;
+    }
+  }
+  
+  
+  void SignedDistanceTransform::
+  resetSpeed()
+  {
+    m_radius.assign(m_grid.nCells(), m_scale);
+  }
+  
+}
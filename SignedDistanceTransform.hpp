@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DTRANS_SIGNED_DISTANCE_TRANSFORM_HPP
+#define DTRANS_SIGNED_DISTANCE_TRANSFORM_HPP
+
+#include "IndexedHeap.hpp"
+#include "GridIndex.hpp"
+#include <vector>
+#include <stddef.h>
+
+
+namespace dtrans {
+  
+  
+  /**
+     Signed distance transform, e.g. for reinitializing a level-set
+     function. The grid is partitioned into an inside (negative
+     distances) and an outside (positive distances), and seeds near
+     the interface carry the signed distance to it. Both sides are
+     propagated in one pass: a single queue orders all cells by the
+     magnitude of their distance, and each cell only takes updates
+     from neighbors on its own side. This is the two-sided scheme of
+     usd/usdtrans.c, but with speeds, scale, gradients, and the
+     indexed heap of DistanceTransform.
+     
+     On each side, the result is the same as that of a
+     DistanceTransform which treats the other side as obstacle.
+  */
+  class SignedDistanceTransform
+  {
+  public:
+    /** Same as DistanceTransform::infinity. */
+    static double const infinity;
+    
+    /** Same as DistanceTransform::epsilon. */
+    static double const epsilon;
+    
+    SignedDistanceTransform(/** number of cells along X */
+			    size_t dimx,
+			    /** number of cells along Y */
+			    size_t dimy,
+			    /** length of the side of one cell */
+			    double scale);
+    
+    inline bool isValid(size_t ix, size_t iy) const { return m_grid.isValid(ix, iy); }
+    inline size_t dimX() const { return m_grid.dim(0); }
+    inline size_t dimY() const { return m_grid.dim(1); }
+    inline double scale() const { return m_scale;}
+    inline size_t index(size_t ix, size_t iy) const { return m_grid.index(ix, iy); }
+    
+    /** Signed distances of all cells, in the same order as given by
+	index(). Cells that have not been reached are at plus or minus
+	infinity, depending on their side. */
+    inline std::vector<double> const & valueArray() const { return m_value; }
+    
+    /** Put a cell on the inside (or back on the outside, which is
+	where all cells start out). This resets its distance, so the
+	partition should be set before seeding.
+	
+	\return False if the cell lies outside the grid. */
+    bool setInside(size_t ix, size_t iy, bool inside);
+    
+    /** \return True if the cell lies on the inside. */
+    bool isInside(size_t ix, size_t iy) const;
+    
+    /** Seed a cell with its signed distance to the interface. A
+	negative distance puts the cell on the inside, a positive one
+	on the outside, and zero leaves it on its side. The
+	propagation will not overwrite the distance of a seed.
+	
+	\return False if the cell lies outside the grid. */
+    bool setDist(size_t ix, size_t iy, double dist);
+    
+    /** Seed every cell that has a neighbor on the other side of the
+	partition (and is not a seed yet) with half a cell, negative
+	on the inside and positive on the outside. That places the
+	interface halfway between cell centers, which is what
+	reinitializing a level set from its sign alone amounts to.
+	
+	\return The number of cells that got seeded. */
+    size_t seedBoundary();
+    
+    /** Set the propagation speed of a cell, see
+	DistanceTransform::setSpeed(). Cells with zero speed are never
+	reached.
+	
+	\note Unlike DistanceTransform, changing speeds after
+	propagating does not repair anything: call resetDist() and
+	seed again.
+	
+	\return False if the speed is out of range or the cell lies
+	outside the grid. */
+    bool setSpeed(size_t ix, size_t iy, double speed);
+    
+    /** \return The signed distance of a cell, or infinity if the
+	cell lies outside the grid. */
+    double getDist(size_t ix, size_t iy) const;
+    
+    /** Propagate both sides until the magnitude of the distance at
+	the top of the queue exceeds the given range, or the queue is
+	empty. */
+    void compute(double range);
+    
+    /** Expand the cell at the top of the queue, whichever side it
+	lies on.
+	
+	\return False if there was nothing left to do. */
+    bool propagate();
+    
+    /** \return The magnitude of the distance at the top of the
+	queue, or infinity if it is empty. */
+    double getTopKey() const;
+    
+    /** Compute the unscaled upwind gradient of the signed distance
+	at a cell. This is the gradient of DistanceTransform (taken
+	over the neighbors on the same side) with the sign of the
+	side applied, so it points from the inside towards the
+	outside on both sides. Nothing gets cached.
+	
+	\return The number of axes that contributed, see
+	DistanceTransform::computeGradient(). */
+    size_t computeGradient(size_t ix, size_t iy,
+			   double & gx, double & gy) const;
+    
+    /** Put all cells back to infinity (with the sign of their side)
+	and clear the queue and the seeds, but keep the partition and
+	the speeds. */
+    void resetDist();
+    
+    /** Put all cells back to unit speed. */
+    void resetSpeed();
+    
+  protected:
+    enum {
+      FIXED = 0x01,		/**< seed, see setDist() */
+      INSIDE = 0x02		/**< negative side of the partition */
+    };
+    
+    GridIndex<2> const m_grid;
+    size_t const m_dimx;	/**< m_grid.dim(0) */
+    size_t const m_toprow;	/**< m_grid.lastSlab() */
+    size_t const m_rightcol;	/**< m_grid.last(0) */
+    double const m_scale;
+    std::vector<double> m_value;
+    std::vector<unsigned char> m_flags;
+    std::vector<double> m_radius; /**< scale/speed, infinity means "obstacle" */
+    IndexedHeap m_queue;	  /**< keyed by the magnitude of the distance */
+    
+    /** \return The magnitude of the distance of a neighbor if it
+	lies on the given side, infinity otherwise. */
+    inline double sideDist(size_t nbor, unsigned char inside) const
+    {
+      if ((m_flags[nbor] & INSIDE) != inside) {
+	return infinity;
+      }
+      return m_value[nbor] < 0 ? -m_value[nbor] : m_value[nbor];
+    }
+    
+    void update(size_t index);
+  };
+  
+}
+
+#endif // DTRANS_SIGNED_DISTANCE_TRANSFORM_HPP
@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "SparseDistanceTransform.hpp"
+#include <limits>
+#include <algorithm>
+#include <math.h>
+
+
+namespace dtrans {
+  
+  double const SparseDistanceTransform::infinity(std::numeric_limits<double>::max());
+  double const SparseDistanceTransform::epsilon(1e-6);
+  
+  
+  /** Offsets to the south, north, west, and east neighbors. */
+  static int const nbor_dx[] = {  0, 0, -1, 1 };
+  static int const nbor_dy[] = { -1, 1,  0, 0 };
+  
+  
+  SparseDistanceTransform::
+  SparseDistanceTransform(size_t dimx, size_t dimy, double scale)
+    : m_dimx(dimx),
+      m_dimy(dimy),
+      m_scale(scale),
+      m_dir((dimx + tilesize - 1) >> tilebits, (dimy + tilesize - 1) >> tilebits),
+      m_tile(m_dir.nCells(), 0),
+      m_band(infinity)
+  {
+  }
+  
+  
+  SparseDistanceTransform::
+  ~SparseDistanceTransform()
+  {
+    for (size_t iu(0); iu < m_used.size(); ++iu) {
+      delete m_tile[m_used[iu]];
+    }
+    for (size_t ii(0); ii < m_spare.size(); ++ii) {
+      delete m_spare[ii];
+    }
+  }
+  
+  
+  size_t SparseDistanceTransform::
+  memoryUsage() const
+  {
+    return (m_used.size() + m_spare.size()) * sizeof(tile_s) + m_tile.capacity() * sizeof(tile_s*);
+  }
+  
+  
+  SparseDistanceTransform::tile_s * SparseDistanceTransform::
+  touch(size_t cc)
+  {
+    size_t const ti(cc >> (2 * tilebits));
+    tile_s * & tile(m_tile[ti]);
+    if ( ! tile) {
+      if (m_spare.empty()) {
+	tile = new tile_s;
+      }
+      else {
+	tile = m_spare.back();
+	m_spare.pop_back();
+      }
+      std::fill(tile->value, tile->value + tilecells, infinity);
+      std::fill(tile->radius, tile->radius + tilecells, m_scale);
+      std::fill(tile->key, tile->key + tilecells, -1.0);
+      tile->slow = false;
+      m_used.push_back(ti);
+    }
+    return tile;
+  }
+  
+  
+  void SparseDistanceTransform::
+  release(size_t iu)
+  {
+    m_spare.push_back(m_tile[m_used[iu]]);
+    m_tile[m_used[iu]] = 0;
+    m_used[iu] = m_used.back();
+    m_used.pop_back();
+  }
+  
+  
+  void SparseDistanceTransform::
+  coords(size_t cc, size_t & ix, size_t & iy) const
+  {
+    size_t const ti(cc >> (2 * tilebits));
+    size_t const off(offsetOf(cc));
+    ix = ((ti % m_dir.dim(0)) << tilebits) | (off & (tilesize - 1));
+    iy = ((ti / m_dir.dim(0)) << tilebits) | (off >> tilebits);
+  }
+  
+  
+  bool SparseDistanceTransform::
+  setDist(size_t ix, size_t iy, double dist)
+  {
+    if ((dist < 0) || ! isValid(ix, iy)) {
+      return false;
+    }
+    size_t const cc(cell(ix, iy));
+    touch(cc)->value[offsetOf(cc)] = -dist; // <=0 means "fixed"
+    requeue(cc, dist);
+    return true;
+  }
+  
+  
+  bool SparseDistanceTransform::
+  setSpeed(size_t ix, size_t iy, double speed)
+  {
+    if ((speed < 0) || (speed > 1) || ! isValid(ix, iy)) {
+      return false;
+    }
+    
+    size_t const cc(cell(ix, iy));
+    double const radius((speed < epsilon) ? infinity : m_scale / speed);
+    tile_s * tile(tileOf(cc));
+    if ( ! tile) {
+      if (radius == m_scale) {
+	return true;		// that is what a missing tile says anyway
+      }
+      tile = touch(cc);
+    }
+    tile->slow = true;
+    
+    size_t const off(offsetOf(cc));
+    double const oldradius(tile->radius[off]);
+    tile->radius[off] = radius;
+    if (tile->value[off] >= infinity) { // not reached yet, nothing to repair
+      return true;
+    }
+    if (radius > oldradius) {
+      raise(ix, iy);
+    }
+    else if (radius < oldradius) {
+      lower(ix, iy);
+    }
+    return true;
+  }
+  
+  
+  double SparseDistanceTransform::
+  getDist(size_t ix, size_t iy) const
+  {
+    if ( ! isValid(ix, iy)) {
+      return infinity;
+    }
+    return fabs(valueOf(cell(ix, iy)));
+  }
+  
+  
+  void SparseDistanceTransform::
+  compute(double ceiling)
+  {
+    for (;;) {
+      prune();
+      if (m_queue.empty() || (m_queue.front().key > ceiling)) {
+	break;
+      }
+      propagate();
+    }
+  }
+  
+  
+  bool SparseDistanceTransform::
+  propagate()
+  {
+    prune();
+    if (m_queue.empty()) {
+      return false;
+    }
+    size_t const cc(m_queue.front().cell);
+    std::pop_heap(m_queue.begin(), m_queue.end());
+    m_queue.pop_back();
+    tileOf(cc)->key[offsetOf(cc)] = -1;
+    
+    size_t ix, iy;
+    coords(cc, ix, iy);
+    if (iy > 0) {		// south
+      update(ix, iy - 1);
+    }
+    if (iy + 1 < m_dimy) {	// north
+      update(ix, iy + 1);
+    }
+    if (ix > 0) {		// west
+      update(ix - 1, iy);
+    }
+    if (ix + 1 < m_dimx) {	// east
+      update(ix + 1, iy);
+    }
+    return true;
+  }
+  
+  
+  double SparseDistanceTransform::
+  getTopKey() const
+  {
+    prune();
+    if (m_queue.empty()) {
+      return infinity;
+    }
+    return m_queue.front().key;
+  }
+  
+  
+  void SparseDistanceTransform::
+  prune() const
+  {
+    while ( ! m_queue.empty()) {
+      size_t const cc(m_queue.front().cell);
+      // Entries of tiles that resetSpeed() has released are stale.
+      tile_s const * tile(tileOf(cc));
+      if (tile && (tile->key[offsetOf(cc)] == m_queue.front().key)) {
+	return;
+      }
+      std::pop_heap(m_queue.begin(), m_queue.end());
+      m_queue.pop_back();
+    }
+  }
+  
+  
+  void SparseDistanceTransform::
+  requeue(size_t cc, double key)
+  {
+    // any older entry of this cell becomes stale
+    tileOf(cc)->key[offsetOf(cc)] = key;
+    entry_s ee;
+    ee.key = key;
+    ee.cell = cc;
+    m_queue.push_back(ee);
+    std::push_heap(m_queue.begin(), m_queue.end());
+  }
+  
+  
+  void SparseDistanceTransform::
+  unqueue(size_t cc)
+  {
+    tileOf(cc)->key[offsetOf(cc)] = -1;
+  }
+  
+  
+  double SparseDistanceTransform::
+  solve(size_t ix, size_t iy) const
+  {
+    // Same as the first-order DistanceTransform::solve(), so that
+    // both give the same results.
+    double ns(infinity);
+    if (iy > 0) {
+      ns = fabs(valueOf(cell(ix, iy - 1)));
+    }
+    if (iy + 1 < m_dimy) {
+      double const nval(fabs(valueOf(cell(ix, iy + 1))));
+      if (nval < ns) {
+	ns = nval;
+      }
+    }
+    double ew(infinity);
+    if (ix > 0) {
+      ew = fabs(valueOf(cell(ix - 1, iy)));
+    }
+    if (ix + 1 < m_dimx) {
+      double const nval(fabs(valueOf(cell(ix + 1, iy))));
+      if (nval < ew) {
+	ew = nval;
+      }
+    }
+    double primary(ns);
+    double secondary(ew);
+    if (secondary < primary) {
+      primary = ew;
+      secondary = ns;
+    }
+    if (primary >= infinity) {
+      return infinity;
+    }
+    
+    double const radius(radiusOf(cell(ix, iy)));
+    if (radius > secondary - primary) {
+      double const dd(secondary - primary);
+      return primary + (dd + sqrt(2 * radius * radius - dd * dd)) / 2;
+    }
+    return primary + radius;
+  }
+  
+  
+  void SparseDistanceTransform::
+  update(size_t ix, size_t iy)
+  {
+    size_t const cc(cell(ix, iy));
+    double const value(valueOf(cc));
+    if (value <= 0) {		// fixed cell, skip it
+      return;
+    }
+    if (radiusOf(cc) >= infinity) { // obstacle, it'll always be at infinity
+      touch(cc)->value[offsetOf(cc)] = -infinity;
+      return;
+    }
+    double const rhs(solve(ix, iy));
+    if ((rhs < value) && (rhs <= m_band)) {
+      touch(cc)->value[offsetOf(cc)] = rhs;
+      requeue(cc, rhs);
+    }
+  }
+  
+  
+  void SparseDistanceTransform::
+  raise(size_t ix, size_t iy)
+  {
+    size_t const start(cell(ix, iy));
+    double const value(valueOf(start));
+    if ((value <= 0) || (value >= infinity)) {
+      return;
+    }
+    
+    // Invalidate the cell and everything downwind of it. A neighbor
+    // depends on a region cell if it lies above it (otherwise the
+    // upwind solution does not use that axis) and the region cell
+    // was the lower of its two neighbors along that axis. Cells with
+    // a finite distance always have a tile.
+    std::vector<size_t> region(1, start);
+    std::vector<double> old(1, value);
+    tileOf(start)->value[offsetOf(start)] = infinity;
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      double const vc(old[ir]);
+      size_t cx, cy;
+      coords(region[ir], cx, cy);
+      for (size_t dd(0); dd < 4; ++dd) {
+	size_t const nx(cx + nbor_dx[dd]); // wraps around to a huge number at 0
+	size_t const ny(cy + nbor_dy[dd]);
+	if ( ! isValid(nx, ny)) {
+	  continue;
+	}
+	size_t const nn(cell(nx, ny));
+	double const vn(valueOf(nn));
+	if ((vn <= vc) || (vn >= infinity)) {
+	  continue;
+	}
+	size_t const bx(nx + nbor_dx[dd]);
+	size_t const by(ny + nbor_dy[dd]);
+	if (isValid(bx, by) && (fabs(valueOf(cell(bx, by))) <= vc)) {
+	  continue;
+	}
+	region.push_back(nn);
+	old.push_back(vn);
+	tileOf(nn)->value[offsetOf(nn)] = infinity;
+      }
+    }
+    
+    // Queue the rim of the region with what it gets from outside.
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      unqueue(cc);
+      if (radiusOf(cc) >= infinity) {
+	old[ir] = -infinity;
+      }
+      else {
+	size_t cx, cy;
+	coords(cc, cx, cy);
+	old[ir] = solve(cx, cy);
+	if (old[ir] > m_band) {
+	  old[ir] = infinity;
+	}
+      }
+    }
+    for (size_t ir(0); ir < region.size(); ++ir) {
+      size_t const cc(region[ir]);
+      tileOf(cc)->value[offsetOf(cc)] = old[ir];
+      if ((old[ir] > 0) && (old[ir] < infinity)) {
+	requeue(cc, old[ir]);
+      }
+    }
+  }
+  
+  
+  void SparseDistanceTransform::
+  lower(size_t ix, size_t iy)
+  {
+    size_t const cc(cell(ix, iy));
+    tile_s * tile(tileOf(cc));
+    size_t const off(offsetOf(cc));
+    if (tile->value[off] <= -infinity) { // obstacle that has become free space
+      tile->value[off] = infinity;
+    }
+    else if (tile->value[off] <= 0) { // seed, does not depend on its speed
+      return;
+    }
+    double const rhs(solve(ix, iy));
+    if ((rhs < tile->value[off]) && (rhs <= m_band)) {
+      tile->value[off] = rhs;
+      requeue(cc, rhs);
+    }
+  }
+  
+  
+  size_t SparseDistanceTransform::
+  computeGradient(size_t ix, size_t iy,
+		  double & gx, double & gy) const
+  {
+    gx = 0;
+    gy = 0;
+    if ( ! isValid(ix, iy)) {
+      return 0;
+    }
+    
+    // same rules as in DistanceTransform::computeGradient()
+    double const height(fabs(valueOf(cell(ix, iy))));
+    double const south(iy > 0 ? fabs(valueOf(cell(ix, iy - 1))) : height);
+    double const north(iy + 1 < m_dimy ? fabs(valueOf(cell(ix, iy + 1))) : height);
+    double const west(ix > 0 ? fabs(valueOf(cell(ix - 1, iy))) : height);
+    double const east(ix + 1 < m_dimx ? fabs(valueOf(cell(ix + 1, iy))) : height);
+    size_t count(0);
+    if ((south < height) || (north < height)) {
+      ++count;
+      gy = (south <= north) ? height - south : north - height;
+    }
+    if ((west < height) || (east < height)) {
+      ++count;
+      gx = (west <= east) ? height - west : east - height;
+    }
+    return count;
+  }
+  
+  
+  void SparseDistanceTransform::
+  resetDist()
+  {
+    m_queue.clear();
+    size_t iu(0);
+    while (iu < m_used.size()) {
+      tile_s * tile(m_tile[m_used[iu]]);
+      if (tile->slow) {
+	std::fill(tile->value, tile->value + tilecells, infinity);
+	std::fill(tile->key, tile->key + tilecells, -1.0);
+	++iu;
+      }
+      else {
+	release(iu);
+      }
+    }
+  }
+  
+  
+  void SparseDistanceTransform::
+  resetSpeed()
+  {
+    size_t iu(0);
+    while (iu < m_used.size()) {
+      tile_s * tile(m_tile[m_used[iu]]);
+      size_t off(0);
+      while ((off < tilecells) && (tile->value[off] >= infinity)) {
+	++off;
+      }
+      if (off == tilecells) {
+	release(iu);
+      }
+      else {
+	std::fill(tile->radius, tile->radius + tilecells, m_scale);
+	tile->slow = false;
+	++iu;
+      }
+    }
+  }
+  
+}
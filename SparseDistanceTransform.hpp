@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef DTRANS_SPARSE_DISTANCE_TRANSFORM_HPP
+#define DTRANS_SPARSE_DISTANCE_TRANSFORM_HPP
+
+#include "GridIndex.hpp"
+#include <vector>
+#include <stddef.h>
+
+
+namespace dtrans {
+  
+  
+  /**
+     Distance transform for huge grids of which only a small part
+     ever gets reached, e.g. exploration maps that are tens of
+     thousands of cells across. The grid is cut into square tiles
+     that get allocated the first time a cell in them is seeded,
+     reached, or given a speed other than one. Untouched tiles cost a
+     null pointer, so memory tracks the area that compute() actually
+     expands (plus whatever has non-unit speeds).
+     
+     The API and the results are those of DistanceTransform with the
+     first-order stencil, including repairs after changing speeds
+     (see DistanceTransform::setSpeed()). The queue is a binary heap
+     with lazy deletion instead of an indexed heap, because the
+     latter would need a slot per cell of the whole grid.
+     
+     For clearance layers and other fields that are only needed up to
+     some distance, setBand() turns this into a narrow-band
+     transform: cells beyond the band are neither stored nor queued,
+     so memory, propagation, and resetDist() all scale with the area
+     of the band instead of the grid.
+  */
+  class SparseDistanceTransform
+  {
+  public:
+    /** Same as DistanceTransform::infinity. */
+    static double const infinity;
+    
+    /** Same as DistanceTransform::epsilon. */
+    static double const epsilon;
+    
+    /** Tiles have 2^tilebits cells along each side. */
+    static size_t const tilebits = 6;
+    static size_t const tilesize = 1 << tilebits;
+    
+    SparseDistanceTransform(/** number of cells along X */
+			    size_t dimx,
+			    /** number of cells along Y */
+			    size_t dimy,
+			    /** length of the side of one cell */
+			    double scale);
+    
+    ~SparseDistanceTransform();
+    
+    inline bool isValid(size_t ix, size_t iy) const
+    { return (ix < m_dimx) && (iy < m_dimy); }
+    
+    inline size_t dimX() const { return m_dimx; }
+    inline size_t dimY() const { return m_dimy; }
+    inline double scale() const { return m_scale;}
+    
+    /** \return The number of tiles that are currently allocated. */
+    inline size_t nTiles() const { return m_used.size(); }
+    
+    /** \return The number of bytes held by the allocated tiles
+	(including the ones kept for reuse, see resetDist()) and the
+	tile directory. The queue is not counted. */
+    size_t memoryUsage() const;
+    
+    /** Limit the transform to a narrow band around the seeds: cells
+	whose distance would exceed the limit stay at infinity, never
+	go on the queue, and do not cause their tile to be
+	allocated. Distances inside the band are the same as without
+	it. Pass infinity (the default) to switch this off.
+	
+	\note The band applies to cells that get updated after this
+	call, so set it before seeding (or call resetDist() after
+	changing it). */
+    inline void setBand(double limit) { m_band = limit; }
+    
+    inline double band() const { return m_band; }
+    
+    /** See DistanceTransform::setDist(). */
+    bool setDist(size_t ix, size_t iy, double dist);
+    
+    /** See DistanceTransform::setSpeed(). Setting a cell to unit
+	speed does not allocate its tile. */
+    bool setSpeed(size_t ix, size_t iy, double speed);
+    
+    /** See DistanceTransform::getDist(). This never allocates. */
+    double getDist(size_t ix, size_t iy) const;
+    
+    /** See DistanceTransform::compute(). Only the tiles that the
+	propagation reaches get allocated, so a finite ceiling keeps
+	memory proportional to the area within that distance. */
+    void compute(double ceiling);
+    
+    /** See DistanceTransform::propagate(). */
+    bool propagate();
+    
+    /** See DistanceTransform::getTopKey(). */
+    double getTopKey() const;
+    
+    /** Compute the unscaled upwind gradient at a cell, with the same
+	semantics as DistanceTransform::computeGradient() except that
+	nothing gets cached. */
+    size_t computeGradient(size_t ix, size_t iy,
+			   double & gx, double & gy) const;
+    
+    /** Put all cells back to infinity and clear the queue. Tiles
+	that only held distances are released, tiles with speeds other
+	than one are kept. This takes time proportional to the number
+	of allocated tiles. Released tiles are kept for reuse, so that
+	recomputing a band every frame does not allocate. */
+    void resetDist();
+    
+    /** Put all cells back to unit speed. Tiles without any
+	distances are released. */
+    void resetSpeed();
+    
+  protected:
+    static size_t const tilecells = tilesize * tilesize;
+    static size_t const npos = static_cast<size_t>(-1);
+    
+    struct tile_s {
+      double value[tilecells];	/**< negative values mean "fixed cell" */
+      double radius[tilecells];	/**< scale/speed, infinity means "obstacle" */
+      double key[tilecells];	/**< a -1 means "not on queue" */
+      bool slow;		/**< some radius may differ from the scale */
+    };
+    
+    struct entry_s {
+      double key;
+      size_t cell;
+      
+      /** Makes std::push_heap() and friends build a min-heap. */
+      inline bool operator < (entry_s const & rhs) const { return key > rhs.key; }
+    };
+    
+    size_t const m_dimx;
+    size_t const m_dimy;
+    double const m_scale;
+    GridIndex<2> const m_dir;	/**< tile coordinates to m_tile index */
+    std::vector<tile_s*> m_tile; /**< null until something gets stored */
+    std::vector<size_t> m_used;	/**< indices of the non-null entries of m_tile */
+    std::vector<tile_s*> m_spare; /**< released tiles, for reuse by touch() */
+    double m_band;		  /**< see setBand() */
+    
+    /** Heap of cells, possibly with stale entries whose key does not
+	match the one stored in the tile anymore. These are skipped
+	when they come up, see prune(). */
+    mutable std::vector<entry_s> m_queue;
+    
+    /** Cells are identified by their tile index (upper bits) and
+	their offset inside the tile (lower bits). */
+    inline size_t cell(size_t ix, size_t iy) const
+    {
+      return (m_dir.index(ix >> tilebits, iy >> tilebits) << (2 * tilebits))
+	| ((iy & (tilesize - 1)) << tilebits) | (ix & (tilesize - 1));
+    }
+    
+    inline tile_s * tileOf(size_t cc) const { return m_tile[cc >> (2 * tilebits)]; }
+    inline size_t offsetOf(size_t cc) const { return cc & (tilecells - 1); }
+    
+    /** \return The distance of a cell (with sign), or infinity if its
+	tile does not exist. */
+    inline double valueOf(size_t cc) const
+    {
+      tile_s const * tile(tileOf(cc));
+      return tile ? tile->value[offsetOf(cc)] : infinity;
+    }
+    
+    inline double radiusOf(size_t cc) const
+    {
+      tile_s const * tile(tileOf(cc));
+      return tile ? tile->radius[offsetOf(cc)] : m_scale;
+    }
+    
+    /** \return The tile of the given cell, allocating it if needed. */
+    tile_s * touch(size_t cc);
+    
+    /** Move a tile from m_tile to m_spare, given its position in
+	m_used. The last entry of m_used takes its place. */
+    void release(size_t iu);
+    
+    /** Inverse of cell(). */
+    void coords(size_t cc, size_t & ix, size_t & iy) const;
+    
+    /** Drop stale entries from the top of the queue. */
+    void prune() const;
+    
+    void requeue(size_t cc, double key);
+    void unqueue(size_t cc);
+    double solve(size_t ix, size_t iy) const;
+    void update(size_t ix, size_t iy);
+    
+    /** See DistanceTransform::raise(). */
+    void raise(size_t ix, size_t iy);
+    
+    /** See DistanceTransform::lower(). */
+    void lower(size_t ix, size_t iy);
+    
+  private:
+    SparseDistanceTransform(SparseDistanceTransform const &);
+    SparseDistanceTransform & operator = (SparseDistanceTransform const &);
+  };
+  
+}
+
+#endif // DTRANS_SPARSE_DISTANCE_TRANSFORM_HPP
@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef DTRANS_SPEED_MAP_HPP
+#define DTRANS_SPEED_MAP_HPP
+
+#include "GridIndex.hpp"
+#include <vector>
+#include <limits>
+#include <math.h>
+#include <stddef.h>
+
+
+namespace dtrans {
+  
+  template<typename Scalar, typename Cells> class BasicDistanceTransform;
+  
+  
+  /**
+     The speed layer of a DistanceTransform: the grid dimensions and
+     scale, plus the LSM radius (scale/speed) of each cell and its
+     square. Several transforms can share one SpeedMap, e.g. to plan
+     to many goals on the same costmap without storing the speeds
+     once per goal. Sharing is reference-counted, and a transform
+     that changes the speeds of a shared map first makes a private
+     copy of it (copy-on-write), so the map is never modified while
+     others can see it.
+     
+     Use DistanceTransform::speedMap() to get hold of the map of an
+     existing transform, and pass it to the DistanceTransform
+     constructor to create transforms that share it.
+     
+     The map is stored in the padded layout of DistanceTransform:
+     the grid is surrounded by a border of one obstacle cell on each
+     side, so that every cell of the grid has four neighbors in
+     memory. Radii are stored with the Scalar type of the transforms
+     that use the map. The squares of the radii are only stored for
+     the split layout, which reads them from here; transforms with
+     PackedCells compute them on the fly and create their maps
+     without them.
+  */
+  template<typename Scalar>
+  class BasicSpeedMap
+  {
+  public:
+    BasicSpeedMap(size_t dimx, size_t dimy, double scale,
+		  /** whether to store the squares of the radii */
+		  bool with_r2 = true)
+      : m_dimx(dimx),
+	m_dimy(dimy),
+	m_scale(scale),
+	m_slots(dimx + 2, dimy + 2),
+	m_radius(m_slots.nCells(), scale),
+	m_r2(with_r2 ? m_slots.nCells() : 0, pow(scale, 2.0)),
+	m_refcount(0)
+    {
+      initBorder();
+    }
+    
+    /** Deep copy, which starts out without any references. The
+	squares of the radii are computed if the original does not
+	have them, or left out if with_r2 is false. */
+    BasicSpeedMap(BasicSpeedMap const & orig, bool with_r2 = true)
+      : m_dimx(orig.m_dimx),
+	m_dimy(orig.m_dimy),
+	m_scale(orig.m_scale),
+	m_slots(orig.m_slots),
+	m_radius(orig.m_radius),
+	m_r2(with_r2 ? orig.m_r2 : std::vector<Scalar>()),
+	m_refcount(0)
+    {
+      if (with_r2 && m_r2.empty()) {
+	initR2();
+      }
+    }
+    
+    inline size_t dimX() const { return m_dimx; }
+    inline size_t dimY() const { return m_dimy; }
+    inline double scale() const { return m_scale; }
+    
+    /** \return The storage slot of a cell, for radiusAt(). Slots
+	along a row are consecutive, so for scanning a row it is
+	enough to look up the slot of its first cell.
+	\note Does not check the coordinates. */
+    inline size_t slot(size_t ix, size_t iy) const
+    { return m_slots.index(ix + 1, iy + 1); }
+    
+    /** \return The LSM radius in the given slot (see slot()),
+	infinity for obstacles. */
+    inline Scalar radiusAt(size_t slot) const { return m_radius[slot]; }
+    
+    /** \return The number of transforms that currently use this map. */
+    inline size_t refCount() const { return m_refcount; }
+    
+  protected:
+    template<typename S, typename Cells> friend class BasicDistanceTransform;
+    
+    size_t const m_dimx;
+    size_t const m_dimy;
+    double const m_scale;
+    GridIndex<2> const m_slots;	/**< the grid plus its border */
+    std::vector<Scalar> m_radius; /**< scale/speed map, infinity means "obstacle" */
+    std::vector<Scalar> m_r2;	/**< square thereof, empty for maps of PackedCells */
+    mutable size_t m_refcount;
+    
+    // Atomic, so that transforms sharing a map can be created and
+    // destroyed from different threads.
+    inline void ref() const { __sync_add_and_fetch(&m_refcount, 1); }
+    
+    /** \return True if that was the last reference. */
+    inline bool unref() const { return 0 == __sync_sub_and_fetch(&m_refcount, 1); }
+    
+    /** Turn the border around the grid into obstacles. */
+    void initBorder()
+    {
+      Scalar const infinity(std::numeric_limits<Scalar>::max());
+      size_t const pitch(m_slots.stride(1));
+      size_t const top(m_slots.lastSlab());
+      for (size_t ix(0); ix < pitch; ++ix) {
+	m_radius[ix] = infinity;
+	m_radius[top + ix] = infinity;
+      }
+      for (size_t ii(pitch); ii < top; ii += pitch) {
+	m_radius[ii] = infinity;
+	m_radius[ii + pitch - 1] = infinity;
+      }
+      if ( ! m_r2.empty()) {
+	initR2();
+      }
+    }
+    
+    /** (Re)compute the squares of all radii, infinity for obstacles. */
+    void initR2()
+    {
+      Scalar const infinity(std::numeric_limits<Scalar>::max());
+      m_r2.resize(m_radius.size());
+      for (size_t ii(0); ii < m_radius.size(); ++ii) {
+	m_r2[ii] = (m_radius[ii] >= infinity) ? infinity : m_radius[ii] * m_radius[ii];
+      }
+    }
+    
+  private:
+    BasicSpeedMap & operator = (BasicSpeedMap const &);
+  };
+  
+  
+  /** The speed map of DistanceTransform. */
+  typedef BasicSpeedMap<double> SpeedMap;
+  
+}
+
+#endif // DTRANS_SPEED_MAP_HPP
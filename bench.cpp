@@ -0,0 +1,1456 @@
+/*
+ * Copyright (c) 2010 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DistanceTransform.hpp"
+#include "DistanceTransform3D.hpp"
+#include "SparseDistanceTransform.hpp"
+#include "SignedDistanceTransform.hpp"
+#include "DaryHeap.hpp"
+#include <vector>
+#include <string>
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+using namespace dtrans;
+using namespace std;
+
+static size_t dim(1000);
+static int repeat(3);
+static size_t maxthreads(8);
+static size_t tilesize(256);
+
+
+static double now()
+{
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+/** Free space everywhere. */
+static void open_field(DistanceTransform & dt)
+{
+}
+
+
+/** Rooms of 16x16 cells separated by walls, with a door at a
+    pseudo-random place in each wall segment. Propagation has to
+    snake through the doors, much like in maze.png. */
+static void maze(DistanceTransform & dt)
+{
+  static size_t const room(16);
+  static size_t const door(3);
+  unsigned int seed(42);
+  for (size_t iy(0); iy < dt.dimY(); iy += room) {
+    for (size_t x0(0); x0 < dt.dimX(); x0 += room) {
+      seed = seed * 1103515245 + 12345;
+      size_t const gap(x0 + 1 + (seed >> 16) % (room - door - 1));
+      for (size_t ix(x0); (ix < x0 + room) && (ix < dt.dimX()); ++ix) {
+	if ((ix < gap) || (ix >= gap + door)) {
+	  dt.setSpeed(ix, iy, 0);
+	}
+      }
+    }
+  }
+  for (size_t ix(0); ix < dt.dimX(); ix += room) {
+    for (size_t y0(0); y0 < dt.dimY(); y0 += room) {
+      seed = seed * 1103515245 + 12345;
+      size_t const gap(y0 + 1 + (seed >> 16) % (room - door - 1));
+      for (size_t iy(y0 + 1); (iy < y0 + room) && (iy < dt.dimY()); ++iy) {
+	if ((iy < gap) || (iy >= gap + door)) {
+	  dt.setSpeed(ix, iy, 0);
+	}
+      }
+    }
+  }
+}
+
+
+typedef void (*map_t)(DistanceTransform &);
+
+static struct map_s {
+  char const * name;
+  map_t setup;
+} const maps[] = {
+  { "open", open_field },
+  { "maze", maze },
+  { 0, 0 }
+};
+
+
+/** Seed the usual goal somewhere off-center in a free cell. */
+template<typename transform_t>
+static void seed(transform_t & dt)
+{
+  dt.setDist(dt.dimX() / 3 + 1, dt.dimY() / 3 + 1, 0);
+}
+
+
+template<typename lhs_t, typename rhs_t>
+static double max_diff(lhs_t const & lhs, rhs_t const & rhs)
+{
+  double maxdiff(0);
+  for (size_t ix(0); ix < lhs.dimX(); ++ix) {
+    for (size_t iy(0); iy < lhs.dimY(); ++iy) {
+      double const ll(lhs.getDist(ix, iy));
+      double const rr(rhs.getDist(ix, iy));
+      if ((ll < lhs_t::infinity) || (rr < rhs_t::infinity)) {
+	double const dd(fabs(ll - rr));
+	if (dd > maxdiff) {
+	  maxdiff = dd;
+	}
+      }
+    }
+  }
+  return maxdiff;
+}
+
+
+static void report(char const * map, char const * what, double dt, double maxerr)
+{
+  printf("  %-6s %-22s %9.4f s %9.2f Mcells/s   max err %g\n",
+	 map, what, dt, dim * dim / dt / 1e6, maxerr);
+}
+
+
+/** Exact heap versus bucket queue of various widths. */
+static void bench_queue()
+{
+  printf("queue: compute(infinity) on %zux%zu grids, best of %d\n", dim, dim, repeat);
+  static double const widths[] = { 0.25, 0.5, 1.0, 0.0 };
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform exact(dim, dim, 1.0);
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      exact.resetDist();
+      exact.resetSpeed();
+      mm->setup(exact);
+      seed(exact);
+      double const t0(now());
+      exact.compute(DistanceTransform::infinity);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "exact", best, 0);
+
+    for (double const * ww(widths); *ww > 0; ++ww) {
+      DistanceTransform bucket(dim, dim, 1.0);
+      mm->setup(bucket);
+      bucket.setQueuePolicy(DistanceTransform::BUCKET_QUEUE, *ww);
+      best = -1;
+      for (int ir(0); ir < repeat; ++ir) {
+	bucket.resetDist();
+	seed(bucket);
+	double const t0(now());
+	bucket.compute(DistanceTransform::infinity);
+	double const tt(now() - t0);
+	if ((best < 0) || (tt < best)) {
+	  best = tt;
+	}
+      }
+      char what[64];
+      snprintf(what, sizeof(what), "bucket width %g", *ww);
+      report(mm->name, what, best, max_diff(exact, bucket));
+    }
+  }
+}
+
+
+/** Gives access to the protected update() kernel. */
+template<typename Scalar, typename Cells>
+class KernelProbe
+  : public BasicDistanceTransform<Scalar, Cells>
+{
+public:
+  typedef BasicDistanceTransform<Scalar, Cells> base_t;
+  
+  KernelProbe(size_t dimx, size_t dimy, double scale)
+    : base_t(dimx, dimy, scale) {}
+  
+  explicit KernelProbe(typename base_t::speed_map_t const * speed)
+    : base_t(speed) {}
+  
+  void updateAll()
+  {
+    for (size_t iy(0); iy < this->m_dimy; ++iy) {
+      for (size_t ix(0); ix < this->m_dimx; ++ix) {
+	this->update(this->slot(ix, iy));
+      }
+    }
+  }
+};
+
+
+/** Throughput of the update() kernel on its own, and of the complete
+    compute(). */
+static void bench_update()
+{
+  printf("update: kernel and compute(infinity) on %zux%zu grids, best of %d\n",
+	 dim, dim, repeat);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    KernelProbe<double, SplitCells> probe(dim, dim, 1.0);
+    mm->setup(probe);
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      probe.resetDist();
+      seed(probe);
+      double const t0(now());
+      probe.compute(DistanceTransform::infinity);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "compute", best, 0);
+    
+    // All cells are settled, so these update() calls do all the work
+    // but change nothing.
+    best = -1;
+    for (int ir(0); ir < repeat; ++ir) {
+      double const t0(now());
+      probe.updateAll();
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "update() per cell", best, 0);
+  }
+}
+
+
+/** Run compute(infinity) and then a pass of update() over all cells
+    nrep times each, and keep the best total times over all runs. */
+template<typename probe_t>
+static void time_probe(probe_t & probe, size_t nrep, double * best)
+{
+  for (int ir(0); ir < repeat; ++ir) {
+    double tt[2] = { 0, 0 };
+    for (size_t ii(0); ii < nrep; ++ii) {
+      probe.resetDist();
+      seed(probe);
+      double const t0(now());
+      probe.compute(DistanceTransform::infinity);
+      double const t1(now());
+      probe.updateAll();
+      double const t2(now());
+      tt[0] += t1 - t0;
+      tt[1] += t2 - t1;
+    }
+    for (size_t ii(0); ii < 2; ++ii) {
+      if ((best[ii] < 0) || (tt[ii] < best[ii])) {
+	best[ii] = tt[ii];
+      }
+    }
+  }
+}
+
+
+/** Split versus packed cells, on a grid that fits into the cache and
+    on the usual one, which (at the default size) does not. The small
+    grid gets computed as many times as it takes to process about the
+    same number of cells. */
+static void bench_layout()
+{
+  static size_t const small(128);
+  size_t const side[] = { small < dim ? small : dim, dim };
+  char const * const where[] = { "cache", "DRAM" };
+  printf("layout: split versus packed cells, compute(infinity) and update() on %zux%zu and"
+	 " %zux%zu grids, best of %d\n", side[0], side[0], side[1], side[1], repeat);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    for (size_t is(0); is < 2; ++is) {
+      size_t const ncells(side[is] * side[is]);
+      size_t const nrep(dim * dim > ncells ? dim * dim / ncells : 1);
+      KernelProbe<double, SplitCells> split(side[is], side[is], 1.0);
+      mm->setup(split);
+      KernelProbe<double, PackedCells> packed(split.speedMap());
+      double best[2][2] = { { -1, -1 }, { -1, -1 } };
+      time_probe(split, nrep, best[0]);
+      time_probe(packed, nrep, best[1]);
+      double const maxerr(max_diff(split, packed));
+      static char const * const layout[] = { "split", "packed" };
+      for (size_t il(0); il < 2; ++il) {
+	for (size_t ik(0); ik < 2; ++ik) {
+	  char what[64];
+	  snprintf(what, sizeof(what), "%s %s %s", where[is], layout[il],
+		   ik ? "update()" : "compute");
+	  printf("  %-6s %-22s %9.4f s %9.2f Mcells/s   max err %g\n",
+		 mm->name, what, best[il][ik], nrep * ncells / best[il][ik] / 1e6,
+		 il ? maxerr : 0.0);
+	}
+      }
+    }
+  }
+}
+
+
+/** Double versus float transforms on the same map. The float one
+    gets its speeds from a buffer, the maps only know how to set up a
+    DistanceTransform. */
+static void bench_precision()
+{
+  printf("precision: double versus float, compute(infinity) and update() on %zux%zu grids,"
+	 " best of %d\n", dim, dim, repeat);
+  vector<float> speed(dim * dim);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    KernelProbe<double, SplitCells> full(dim, dim, 1.0);
+    mm->setup(full);
+    for (size_t iy(0); iy < dim; ++iy) {
+      size_t const offset(full.speedMap()->slot(0, iy));
+      for (size_t ix(0); ix < dim; ++ix) {
+	double const radius(full.speedMap()->radiusAt(offset + ix));
+	speed[full.index(ix, iy)] = (radius < DistanceTransform::infinity) ? 1.0 / radius : 0.0;
+      }
+    }
+    KernelProbe<float, SplitCells> single(dim, dim, 1.0);
+    single.setSpeedBuffer(&speed[0], dim);
+    double best[2][2] = { { -1, -1 }, { -1, -1 } };
+    time_probe(full, 1, best[0]);
+    time_probe(single, 1, best[1]);
+    double const maxerr(max_diff(full, single));
+    static char const * const precision[] = { "double", "float" };
+    for (size_t ip(0); ip < 2; ++ip) {
+      char what[64];
+      snprintf(what, sizeof(what), "%s compute", precision[ip]);
+      report(mm->name, what, best[ip][0], ip ? maxerr : 0.0);
+      snprintf(what, sizeof(what), "%s update()", precision[ip]);
+      report(mm->name, what, best[ip][1], ip ? maxerr : 0.0);
+    }
+  }
+}
+
+
+/** Per-cell computeGradient() versus computeGradientField(). */
+static void bench_gradient()
+{
+  printf("gradient: entire field of %zux%zu grids, best of %d\n", dim, dim, repeat);
+  vector<double> gx(dim * dim);
+  vector<double> gy(dim * dim);
+  vector<size_t> count(dim * dim);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform dt(dim, dim, 1.0);
+    mm->setup(dt);
+    seed(dt);
+    dt.compute(DistanceTransform::infinity);
+    
+    // The per-cell version caches its results, so each run needs a
+    // fresh copy of the transform.
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      DistanceTransform copy(dt);
+      double const t0(now());
+      for (size_t iy(0); iy < dim; ++iy) {
+	for (size_t ix(0); ix < dim; ++ix) {
+	  size_t const ixy(copy.index(ix, iy));
+	  count[ixy] = copy.computeGradient(ix, iy, gx[ixy], gy[ixy]);
+	}
+      }
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "computeGradient()", best, 0);
+    
+    best = -1;
+    for (int ir(0); ir < repeat; ++ir) {
+      double const t0(now());
+      dt.computeGradientField(&gx[0], &gy[0], &count[0]);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "computeGradientField()", best, 0);
+  }
+}
+
+
+/** Fast marching (queue) versus fast sweeping. */
+static void bench_sweep()
+{
+  printf("sweep: compute(infinity) versus computeSweep(0) on %zux%zu grids, best of %d\n",
+	 dim, dim, repeat);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform march(dim, dim, 1.0);
+    mm->setup(march);
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      march.resetDist();
+      seed(march);
+      double const t0(now());
+      march.compute(DistanceTransform::infinity);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "fast marching", best, 0);
+    
+    DistanceTransform sweep(dim, dim, 1.0);
+    mm->setup(sweep);
+    best = -1;
+    size_t nsweeps(0);
+    for (int ir(0); ir < repeat; ++ir) {
+      sweep.resetDist();
+      seed(sweep);
+      double const t0(now());
+      nsweeps = sweep.computeSweep(0, 100000);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    char what[64];
+    snprintf(what, sizeof(what), "fast sweeping (%zu)", nsweeps);
+    report(mm->name, what, best, max_diff(march, sweep));
+  }
+}
+
+
+/** Fast marching versus the exact Euclidean transform on the open
+    map (the only uniform one). The max err column is the
+    approximation error of fast marching. */
+static void bench_exact()
+{
+  printf("exact: compute(infinity) versus computeEuclidean() on %zux%zu grids, best of %d\n",
+	 dim, dim, repeat);
+  DistanceTransform march(dim, dim, 1.0);
+  double best(-1);
+  for (int ir(0); ir < repeat; ++ir) {
+    march.resetDist();
+    seed(march);
+    double const t0(now());
+    march.compute(DistanceTransform::infinity);
+    double const tt(now() - t0);
+    if ((best < 0) || (tt < best)) {
+      best = tt;
+    }
+  }
+  report("open", "fast marching", best, 0);
+  
+  DistanceTransform exact(dim, dim, 1.0);
+  best = -1;
+  for (int ir(0); ir < repeat; ++ir) {
+    exact.resetDist();
+    seed(exact);
+    double const t0(now());
+    if ( ! exact.computeEuclidean()) {
+      errx(EXIT_FAILURE, "computeEuclidean() failed");
+    }
+    double const tt(now() - t0);
+    if ((best < 0) || (tt < best)) {
+      best = tt;
+    }
+  }
+  report("open", "exact Euclidean", best, max_diff(march, exact));
+}
+
+
+/** Repairing after a small obstacle appears (and disappears again),
+    versus recomputing from scratch. The obstacle is a 5x5 block
+    halfway between the seed and the far corner, in the middle of a
+    room of the maze. */
+static void bench_replan()
+{
+  printf("replan: incremental repair versus resetDist() and compute()"
+	 " on %zux%zu grids, best of %d\n", dim, dim, repeat);
+  size_t const bx(2 * dim / 3 / 16 * 16 + 6);
+  size_t const by(bx);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform full(dim, dim, 1.0);
+    mm->setup(full);
+    for (size_t ix(bx); ix < bx + 5; ++ix) {
+      for (size_t iy(by); iy < by + 5; ++iy) {
+	full.setSpeed(ix, iy, 0);
+      }
+    }
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      full.resetDist();
+      seed(full);
+      double const t0(now());
+      full.compute(DistanceTransform::infinity);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "from scratch", best, 0);
+    
+    DistanceTransform inc(dim, dim, 1.0);
+    mm->setup(inc);
+    seed(inc);
+    inc.compute(DistanceTransform::infinity);
+    double best_add(-1);
+    double best_del(-1);
+    double maxerr(0);
+    for (int ir(0); ir < repeat; ++ir) {
+      double t0(now());
+      for (size_t ix(bx); ix < bx + 5; ++ix) {
+	for (size_t iy(by); iy < by + 5; ++iy) {
+	  inc.setSpeed(ix, iy, 0);
+	}
+      }
+      inc.compute(DistanceTransform::infinity);
+      double tt(now() - t0);
+      if ((best_add < 0) || (tt < best_add)) {
+	best_add = tt;
+      }
+      maxerr = max_diff(full, inc);
+      
+      t0 = now();
+      for (size_t ix(bx); ix < bx + 5; ++ix) {
+	for (size_t iy(by); iy < by + 5; ++iy) {
+	  inc.setSpeed(ix, iy, 1);
+	}
+      }
+      inc.compute(DistanceTransform::infinity);
+      tt = now() - t0;
+      if ((best_del < 0) || (tt < best_del)) {
+	best_del = tt;
+      }
+    }
+    report(mm->name, "add obstacle", best_add, maxerr);
+    report(mm->name, "remove obstacle", best_del, 0);
+  }
+}
+
+
+/** Loading speeds and seeds from an 8-bit image, one cell at a time
+    versus the bulk setters. The image is a random mix of obstacles,
+    slow and fast cells, with one seed every 1000 cells or so. */
+static void bench_ingest()
+{
+  printf("ingest: setSpeed() and setDist() versus setSpeedBuffer() and setDistBuffer()"
+	 " on %zux%zu grids, best of %d\n", dim, dim, repeat);
+  vector<unsigned char> image(dim * dim);
+  unsigned int seed(42);
+  for (size_t ii(0); ii < image.size(); ++ii) {
+    seed = seed * 1103515245 + 12345;
+    image[ii] = (seed >> 16) & 0xff;
+  }
+  double speed[256];
+  double dist[256];
+  for (size_t ii(0); ii < 256; ++ii) {
+    speed[ii] = (ii < 25) ? 0 : ii / 255.0;
+    dist[ii] = -1;
+  }
+  dist[255] = 0;		// together with speed 1
+  
+  DistanceTransform cell(dim, dim, 1.0);
+  double best(-1);
+  for (int ir(0); ir < repeat; ++ir) {
+    cell.resetDist();
+    cell.resetSpeed();
+    double const t0(now());
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	unsigned char const pixel(image[ix + iy * dim]);
+	cell.setSpeed(ix, iy, speed[pixel]);
+	if (dist[pixel] >= 0) {
+	  cell.setDist(ix, iy, dist[pixel]);
+	}
+      }
+    }
+    double const tt(now() - t0);
+    if ((best < 0) || (tt < best)) {
+      best = tt;
+    }
+  }
+  report("random", "per cell", best, 0);
+  
+  DistanceTransform bulk(dim, dim, 1.0);
+  best = -1;
+  for (int ir(0); ir < repeat; ++ir) {
+    bulk.resetDist();
+    bulk.resetSpeed();
+    double const t0(now());
+    bulk.setSpeedBuffer(&image[0], dim, speed);
+    bulk.setDistBuffer(&image[0], dim, dist);
+    double const tt(now() - t0);
+    if ((best < 0) || (tt < best)) {
+      best = tt;
+    }
+  }
+  cell.compute(DistanceTransform::infinity);
+  bulk.compute(DistanceTransform::infinity);
+  report("random", "bulk", best, max_diff(cell, bulk));
+  
+  // one row per call, as PNGIO::createTransform() does
+  DistanceTransform rows(dim, dim, 1.0);
+  best = -1;
+  for (int ir(0); ir < repeat; ++ir) {
+    rows.resetDist();
+    rows.resetSpeed();
+    double const t0(now());
+    for (size_t iy(0); iy < dim; ++iy) {
+      rows.setSpeedBuffer(&image[iy * dim], 0, speed, iy, 1);
+      rows.setDistBuffer(&image[iy * dim], 0, dist, iy, 1);
+    }
+    double const tt(now() - t0);
+    if ((best < 0) || (tt < best)) {
+      best = tt;
+    }
+  }
+  rows.compute(DistanceTransform::infinity);
+  report("random", "bulk per row", best, max_diff(cell, rows));
+}
+
+
+/** Replanning to a new goal many times, where each query only
+    computes a small neighborhood (a ceiling of 30 cells) around its
+    goal. Compared to resetting after the whole grid was touched. */
+static void bench_reset()
+{
+  printf("reset: resetDist() plus local compute() versus resetDist() of the whole grid"
+	 " on %zux%zu grids, best of %d\n", dim, dim, repeat);
+  static size_t const nqueries(100);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform dt(dim, dim, 1.0);
+    mm->setup(dt);
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      dt.resetDist();
+      dt.compute(DistanceTransform::infinity);
+      double const t0(now());
+      for (size_t iq(0); iq < nqueries; ++iq) {
+	dt.resetDist();
+	dt.setDist((iq * 37 + 5) % dim, (iq * 53 + 7) % dim, 0);
+	dt.compute(30);
+      }
+      double const tt((now() - t0) / nqueries);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    printf("  %-6s %-22s %9.6f s per query\n", mm->name, "local queries", best);
+    
+    best = -1;
+    for (int ir(0); ir < repeat; ++ir) {
+      dt.resetDist();
+      seed(dt);
+      dt.compute(DistanceTransform::infinity);
+      double const t0(now());
+      dt.resetDist();
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    printf("  %-6s %-22s %9.6f s\n", mm->name, "full reset", best);
+  }
+}
+
+
+/** Point-to-point queries: full compute() versus computeUntil() with
+    various heuristic weights, for a target some way off the seed. Also
+    reports how many cells got a distance, as a measure of the
+    expansion work, and the error at the target. */
+static void bench_until()
+{
+  printf("until: compute(infinity) versus computeUntil() on %zux%zu grids, best of %d\n",
+	 dim, dim, repeat);
+  size_t const tx(dim - dim / 6);
+  size_t const ty(dim / 2 + dim / 8 + 1);
+  static double const weight[] = { -1, 0, 0.5, 0.75, 1 };
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform dt(dim, dim, 1.0);
+    mm->setup(dt);
+    double reference(0);
+    for (size_t iw(0); iw < sizeof(weight) / sizeof(*weight); ++iw) {
+      double best(-1);
+      for (int ir(0); ir < repeat; ++ir) {
+	dt.resetDist();
+	seed(dt);
+	double const t0(now());
+	if (weight[iw] < 0) {
+	  dt.compute(DistanceTransform::infinity);
+	}
+	else {
+	  dt.computeUntil(tx, ty, weight[iw]);
+	}
+	double const tt(now() - t0);
+	if ((best < 0) || (tt < best)) {
+	  best = tt;
+	}
+      }
+      char what[64];
+      if (weight[iw] < 0) {
+	reference = dt.getDist(tx, ty);
+	snprintf(what, sizeof(what), "compute(infinity)");
+      }
+      else {
+	snprintf(what, sizeof(what), "computeUntil(%g)", weight[iw]);
+      }
+      size_t nreached(0);
+      for (size_t ix(0); ix < dim; ++ix) {
+	for (size_t iy(0); iy < dim; ++iy) {
+	  if (dt.getDist(ix, iy) < DistanceTransform::infinity) {
+	    ++nreached;
+	  }
+	}
+      }
+      printf("  %-6s %-24s %9.4f s %9zu cells reached   target err %g\n",
+	     mm->name, what, best, nreached, dt.getDist(tx, ty) - reference);
+    }
+  }
+}
+
+
+/** compute(infinity) in one go versus spread over time slices of
+    20 ms, as in a control loop. Reports the number of slices, and
+    the longest one to show how far the budget gets overrun. */
+static void bench_budget()
+{
+  static double const slice(0.02);
+  printf("budget: compute(infinity) versus computeForTime(%g) slices"
+	 " on %zux%zu grids, best of %d\n", slice, dim, dim, repeat);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform dt(dim, dim, 1.0);
+    mm->setup(dt);
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      dt.resetDist();
+      seed(dt);
+      double const t0(now());
+      dt.compute(DistanceTransform::infinity);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "compute(infinity)", best, 0);
+    
+    best = -1;
+    size_t nslices(0);
+    double longest(0);
+    for (int ir(0); ir < repeat; ++ir) {
+      dt.resetDist();
+      seed(dt);
+      nslices = 0;
+      double const t0(now());
+      for (;;) {
+	double const t1(now());
+	DistanceTransform::progress_s const pp(dt.computeForTime(slice));
+	double const t2(now());
+	++nslices;
+	if (t2 - t1 > longest) {
+	  longest = t2 - t1;
+	}
+	if (pp.top_key >= DistanceTransform::infinity) {
+	  break;
+	}
+      }
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    char what[64];
+    snprintf(what, sizeof(what), "%zu slices, max %.1f ms", nslices, 1e3 * longest);
+    report(mm->name, what, best, 0);
+  }
+}
+
+
+/** Many goals on the same map: one transform with its own speed map
+    per goal, computed one after the other, versus transforms sharing
+    one speed map computed with computeBatch(). */
+static void bench_batch()
+{
+  static size_t const ngoals(16);
+  printf("batch: %zu goals on %zux%zu grids, best of %d\n", ngoals, dim, dim, repeat);
+  double const mb(dim * dim * 2 * sizeof(double) / 1e6);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    vector<DistanceTransform*> batch;
+    for (size_t ig(0); ig < ngoals; ++ig) {
+      batch.push_back(new DistanceTransform(dim, dim, 1.0));
+      mm->setup(*batch.back());
+    }
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      for (size_t ig(0); ig < ngoals; ++ig) {
+	batch[ig]->resetDist();
+	batch[ig]->setDist((ig * 37 + 5) % dim, (ig * 53 + 7) % dim, 0);
+      }
+      double const t0(now());
+      for (size_t ig(0); ig < ngoals; ++ig) {
+	batch[ig]->compute(DistanceTransform::infinity);
+      }
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    printf("  %-6s %-22s %9.4f s   speed maps %7.1f MB\n", mm->name, "separate, serial", best,
+	   ngoals * mb);
+    for (size_t ig(0); ig < ngoals; ++ig) {
+      delete batch[ig];
+    }
+    
+    DistanceTransform proto(dim, dim, 1.0);
+    mm->setup(proto);
+    batch.clear();
+    for (size_t ig(0); ig < ngoals; ++ig) {
+      batch.push_back(new DistanceTransform(proto.speedMap()));
+    }
+    for (size_t nthreads(1); nthreads <= maxthreads; nthreads *= 2) {
+      best = -1;
+      for (int ir(0); ir < repeat; ++ir) {
+	for (size_t ig(0); ig < ngoals; ++ig) {
+	  batch[ig]->resetDist();
+	  batch[ig]->setDist((ig * 37 + 5) % dim, (ig * 53 + 7) % dim, 0);
+	}
+	double const t0(now());
+	DistanceTransform::computeBatch(batch, nthreads);
+	double const tt(now() - t0);
+	if ((best < 0) || (tt < best)) {
+	  best = tt;
+	}
+      }
+      char what[64];
+      snprintf(what, sizeof(what), "shared, %zu threads", nthreads);
+      printf("  %-6s %-22s %9.4f s   speed maps %7.1f MB\n", mm->name, what, best, mb);
+    }
+    for (size_t ig(0); ig < ngoals; ++ig) {
+      delete batch[ig];
+    }
+  }
+}
+
+
+/** Nearest-source partition of several sources: one transform per
+    source versus a single labeled transform. Also shows the overhead
+    of labels compared to the same computation without them. */
+static void bench_label()
+{
+  static size_t const nsrc(8);
+  printf("label: Voronoi partition of %zu sources on %zux%zu grids, best of %d\n",
+	 nsrc, dim, dim, repeat);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform dt(dim, dim, 1.0);
+    mm->setup(dt);
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      double const t0(now());
+      for (size_t is(0); is < nsrc; ++is) {
+	dt.resetDist();
+	dt.setDist((is * 37 + 5) % dim, (is * 53 + 7) % dim, 0);
+	dt.compute(DistanceTransform::infinity);
+      }
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "one per source", best, 0);
+    
+    for (int labeled(0); labeled < 2; ++labeled) {
+      best = -1;
+      for (int ir(0); ir < repeat; ++ir) {
+	dt.resetDist();
+	for (size_t is(0); is < nsrc; ++is) {
+	  if (labeled) {
+	    dt.setDist((is * 37 + 5) % dim, (is * 53 + 7) % dim, 0, is);
+	  }
+	  else {
+	    dt.setDist((is * 37 + 5) % dim, (is * 53 + 7) % dim, 0);
+	  }
+	}
+	double const t0(now());
+	dt.compute(DistanceTransform::infinity);
+	double const tt(now() - t0);
+	if ((best < 0) || (tt < best)) {
+	  best = tt;
+	}
+      }
+      report(mm->name, labeled ? "all sources, labeled" : "all sources, no labels", best, 0);
+    }
+  }
+}
+
+
+/** Accuracy versus cost of the first- and second-order stencils on
+    an analytic case: a point source in the middle of the unit square
+    with uniform speed, at cell sizes from 1/50 down to about
+    1/dim. The cells within 0.1 of the source are either seeded with
+    their exact distance, or the source is a single seed cell. */
+static void bench_order()
+{
+  printf("order: point source on the unit square, first- versus second-order stencil,"
+	 " best of %d\n", repeat);
+  printf("  %-6s %-6s %-9s %5s %9s %11s %11s\n",
+	 "init", "order", "h", "n", "time", "max err", "mean err");
+  for (int disk(1); disk >= 0; --disk) {
+    for (int second(0); second < 2; ++second) {
+      for (size_t nn(51); nn <= dim + 1; nn = 2 * nn - 1) {
+	double const hh(1.0 / (nn - 1));
+	DistanceTransform dt(nn, nn, hh);
+	dt.setStencil(second ? DistanceTransform::SECOND_ORDER : DistanceTransform::FIRST_ORDER);
+	double best(-1);
+	for (int ir(0); ir < repeat; ++ir) {
+	  dt.resetDist();
+	  for (size_t ix(0); ix < nn; ++ix) {
+	    for (size_t iy(0); iy < nn; ++iy) {
+	      double const dd(hypot(ix * hh - 0.5, iy * hh - 0.5));
+	      if ((0 == dd) || (disk && (dd <= 0.1))) {
+		dt.setDist(ix, iy, dd);
+	      }
+	    }
+	  }
+	  double const t0(now());
+	  dt.compute(DistanceTransform::infinity);
+	  double const tt(now() - t0);
+	  if ((best < 0) || (tt < best)) {
+	    best = tt;
+	  }
+	}
+	double maxerr(0);
+	double sumerr(0);
+	for (size_t ix(0); ix < nn; ++ix) {
+	  for (size_t iy(0); iy < nn; ++iy) {
+	    double const ee(fabs(dt.getDist(ix, iy) - hypot(ix * hh - 0.5, iy * hh - 0.5)));
+	    if (ee > maxerr) {
+	      maxerr = ee;
+	    }
+	    sumerr += ee;
+	  }
+	}
+	printf("  %-6s %-6s %-9.6f %5zu %9.4f s %11.3e %11.3e\n", disk ? "disk" : "point",
+	       second ? "second" : "first", hh, nn, best, maxerr, sumerr / (nn * nn));
+      }
+    }
+  }
+}
+
+
+/** Voxel grids with about as many cells as the 2D maps, next to a
+    single slab of the 2D size that shows the cost of the extra
+    axis. The cube gets the 2D map (at its own size) extruded along
+    Z. */
+static void bench_voxel()
+{
+  size_t const side(static_cast<size_t>(cbrt(static_cast<double>(dim * dim)) + 0.5));
+  printf("voxel: compute(infinity) on %zux%zu, %zux%zux1, and %zu^3 grids, best of %d\n",
+	 dim, dim, dim, dim, side, repeat);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform flat(dim, dim, 1.0);
+    DistanceTransform small(side, side, 1.0);
+    mm->setup(flat);
+    mm->setup(small);
+    DistanceTransform3D slab(dim, dim, 1, 1.0);
+    DistanceTransform3D cube(side, side, side, 1.0);
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	if (flat.speedMap()->radiusAt(flat.speedMap()->slot(ix, iy)) >= DistanceTransform::infinity) {
+	  slab.setSpeed(ix, iy, 0, 0);
+	}
+      }
+    }
+    for (size_t iy(0); iy < side; ++iy) {
+      for (size_t ix(0); ix < side; ++ix) {
+	if (small.speedMap()->radiusAt(small.speedMap()->slot(ix, iy)) >= DistanceTransform::infinity) {
+	  for (size_t iz(0); iz < side; ++iz) {
+	    cube.setSpeed(ix, iy, iz, 0);
+	  }
+	}
+      }
+    }
+    
+    double best[3] = { -1, -1, -1 };
+    for (int ir(0); ir < repeat; ++ir) {
+      flat.resetDist();
+      slab.resetDist();
+      cube.resetDist();
+      seed(flat);
+      slab.setDist(dim / 3 + 1, dim / 3 + 1, 0, 0);
+      cube.setDist(side / 3 + 1, side / 3 + 1, side / 2, 0);
+      double const t0(now());
+      flat.compute(DistanceTransform::infinity);
+      double const t1(now());
+      slab.compute(DistanceTransform3D::infinity);
+      double const t2(now());
+      cube.compute(DistanceTransform3D::infinity);
+      double const t3(now());
+      double const tt[3] = { t1 - t0, t2 - t1, t3 - t2 };
+      for (size_t ii(0); ii < 3; ++ii) {
+	if ((best[ii] < 0) || (tt[ii] < best[ii])) {
+	  best[ii] = tt[ii];
+	}
+      }
+    }
+    double maxerr(0);
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	double const ee(fabs(flat.getDist(ix, iy) - slab.getDist(ix, iy, 0)));
+	if ((ee > maxerr) && (flat.getDist(ix, iy) < DistanceTransform::infinity)) {
+	  maxerr = ee;
+	}
+      }
+    }
+    report(mm->name, "2D", best[0], 0);
+    report(mm->name, "3D slab", best[1], maxerr);
+    printf("  %-6s %-22s %9.4f s %9.2f Mcells/s\n",
+	   mm->name, "3D cube", best[2], side * side * side / best[2] / 1e6);
+  }
+}
+
+
+/** Dense versus tiled storage: full transforms on the usual maps,
+    then bounded queries on a grid far too big for dense storage. */
+static void bench_sparse()
+{
+  printf("sparse: dense versus tiled compute(infinity) on %zux%zu grids, best of %d\n",
+	 dim, dim, repeat);
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform dense(dim, dim, 1.0);
+    SparseDistanceTransform sparse(dim, dim, 1.0);
+    mm->setup(dense);
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	if (dense.speedMap()->radiusAt(dense.speedMap()->slot(ix, iy)) >= DistanceTransform::infinity) {
+	  sparse.setSpeed(ix, iy, 0);
+	}
+      }
+    }
+    double best[2] = { -1, -1 };
+    for (int ir(0); ir < repeat; ++ir) {
+      dense.resetDist();
+      sparse.resetDist();
+      seed(dense);
+      sparse.setDist(dim / 3 + 1, dim / 3 + 1, 0);
+      double const t0(now());
+      dense.compute(DistanceTransform::infinity);
+      double const t1(now());
+      sparse.compute(SparseDistanceTransform::infinity);
+      double const t2(now());
+      if ((best[0] < 0) || (t1 - t0 < best[0])) {
+	best[0] = t1 - t0;
+      }
+      if ((best[1] < 0) || (t2 - t1 < best[1])) {
+	best[1] = t2 - t1;
+      }
+    }
+    double maxerr(0);
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	double const ee(fabs(dense.getDist(ix, iy) - sparse.getDist(ix, iy)));
+	if ((ee > maxerr) && (dense.getDist(ix, iy) < DistanceTransform::infinity)) {
+	  maxerr = ee;
+	}
+      }
+    }
+    report(mm->name, "dense", best[0], 0);
+    report(mm->name, "sparse", best[1], maxerr);
+  }
+  
+  static size_t const huge(50000);
+  printf("sparse: compute(ceiling) from the center of a %zux%zu grid"
+	 " (dense would need about %.0f GB)\n", huge, huge, huge * huge * 40.0 / 1e9);
+  printf("  %-8s %9s %8s %10s\n", "ceiling", "time", "tiles", "memory");
+  SparseDistanceTransform sparse(huge, huge, 1.0);
+  for (double ceiling(100); ceiling <= 1600; ceiling *= 2) {
+    sparse.resetDist();
+    sparse.setDist(huge / 2, huge / 2, 0);
+    double const t0(now());
+    sparse.compute(ceiling);
+    double const tt(now() - t0);
+    printf("  %-8g %9.4f s %8zu %7.1f MB\n",
+	   ceiling, tt, sparse.nTiles(), sparse.memoryUsage() / 1048576.0);
+  }
+}
+
+
+/** Clearance layer recomputed from scratch every frame: the seeds
+    are obstacle cells scattered over the sensor range of a robot
+    (the central fifth of the map, one obstacle per 500 cells), and
+    only distances up to the band limit are needed. The dense
+    transform stops at the same ceiling. */
+static void bench_band()
+{
+  size_t const range(dim / 5);
+  std::vector<size_t> wx, wy;
+  unsigned int rnd(42);
+  for (size_t ii(0); ii < range * range / 500; ++ii) {
+    rnd = rnd * 1103515245 + 12345;
+    wx.push_back((dim - range) / 2 + (rnd >> 8) % range);
+    rnd = rnd * 1103515245 + 12345;
+    wy.push_back((dim - range) / 2 + (rnd >> 8) % range);
+  }
+  printf("band: per-frame clearance around %zu obstacles within %zux%zu cells"
+	 " of a %zux%zu grid, best of %d\n", wx.size(), range, range, dim, dim, repeat);
+  
+  printf("  %-6s %-22s %9s %10s %10s\n", "band", "method", "per frame", "memory", "max err");
+  for (double band(2); band <= 32; band *= 4) {
+    DistanceTransform dense(dim, dim, 1.0);
+    SparseDistanceTransform sparse(dim, dim, 1.0);
+    sparse.setBand(band);
+    double best[2] = { -1, -1 };
+    for (int ir(0); ir < repeat; ++ir) {
+      double const t0(now());
+      dense.resetDist();
+      for (size_t ii(0); ii < wx.size(); ++ii) {
+	dense.setDist(wx[ii], wy[ii], 0);
+      }
+      dense.compute(band);
+      double const t1(now());
+      sparse.resetDist();
+      for (size_t ii(0); ii < wx.size(); ++ii) {
+	sparse.setDist(wx[ii], wy[ii], 0);
+      }
+      sparse.compute(SparseDistanceTransform::infinity);
+      double const t2(now());
+      if ((best[0] < 0) || (t1 - t0 < best[0])) {
+	best[0] = t1 - t0;
+      }
+      if ((best[1] < 0) || (t2 - t1 < best[1])) {
+	best[1] = t2 - t1;
+      }
+    }
+    double maxerr(0);
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	// cells right at the limit may fall on either side of it
+	if (dense.getDist(ix, iy) <= band - 1e-9) {
+	  double const ee(fabs(dense.getDist(ix, iy) - sparse.getDist(ix, iy)));
+	  if (ee > maxerr) {
+	    maxerr = ee;
+	  }
+	}
+      }
+    }
+    printf("  %-6g %-22s %9.4f s %7.1f MB\n", band, "dense compute(band)", best[0],
+	   dim * dim * 40.0 / 1048576.0);
+    printf("  %-6g %-22s %9.4f s %7.1f MB %10g\n", band, "sparse setBand(band)", best[1],
+	   sparse.memoryUsage() / 1048576.0, maxerr);
+  }
+}
+
+
+/** Level-set reinitialization of a disk: one signed transform versus
+    two unsigned ones that each treat the other side as obstacle. Both
+    include setting up the partition and seeding the boundary. */
+static void bench_signed()
+{
+  printf("signed: reinitializing a disk on %zux%zu grids, best of %d\n", dim, dim, repeat);
+  double const rr(dim / 3.0);
+  std::vector<char> in(dim * dim);
+  for (size_t iy(0); iy < dim; ++iy) {
+    for (size_t ix(0); ix < dim; ++ix) {
+      in[ix + dim * iy] = hypot(ix - dim / 2.0, iy - dim / 2.0) < rr;
+    }
+  }
+  
+  double best[2] = { -1, -1 };
+  double maxerr(0);
+  for (int ir(0); ir < repeat; ++ir) {
+    double const t0(now());
+    SignedDistanceTransform sdt(dim, dim, 1.0);
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	if (in[ix + dim * iy]) {
+	  sdt.setInside(ix, iy, true);
+	}
+      }
+    }
+    sdt.seedBoundary();
+    sdt.compute(SignedDistanceTransform::infinity);
+    double const t1(now());
+    DistanceTransform inside(dim, dim, 1.0);
+    DistanceTransform outside(dim, dim, 1.0);
+    for (size_t iy(0); iy < dim; ++iy) {
+      for (size_t ix(0); ix < dim; ++ix) {
+	(in[ix + dim * iy] ? outside : inside).setSpeed(ix, iy, 0);
+      }
+    }
+    for (size_t iy(1); iy + 1 < dim; ++iy) {
+      for (size_t ix(1); ix + 1 < dim; ++ix) {
+	size_t const cc(ix + dim * iy);
+	if ((in[cc] != in[cc - 1]) || (in[cc] != in[cc + 1])
+	    || (in[cc] != in[cc - dim]) || (in[cc] != in[cc + dim])) {
+	  (in[cc] ? inside : outside).setDist(ix, iy, 0.5);
+	}
+      }
+    }
+    inside.compute(DistanceTransform::infinity);
+    outside.compute(DistanceTransform::infinity);
+    double const t2(now());
+    if ((best[0] < 0) || (t1 - t0 < best[0])) {
+      best[0] = t1 - t0;
+    }
+    if ((best[1] < 0) || (t2 - t1 < best[1])) {
+      best[1] = t2 - t1;
+    }
+    if (0 == ir) {
+      for (size_t iy(0); iy < dim; ++iy) {
+	for (size_t ix(0); ix < dim; ++ix) {
+	  double const want(in[ix + dim * iy] ? -inside.getDist(ix, iy) : outside.getDist(ix, iy));
+	  if (fabs(sdt.getDist(ix, iy) - want) > maxerr) {
+	    maxerr = fabs(sdt.getDist(ix, iy) - want);
+	  }
+	}
+      }
+    }
+  }
+  report("disk", "one signed pass", best[0], maxerr);
+  report("disk", "two unsigned passes", best[1], 0);
+}
+
+
+/** Run a fast-marching-like workload on a heap: fill it with random
+    keys, then pop the top and decrease two random keys until it is
+    empty. Returns the time and the sum of popped keys in popsum. */
+template<typename heap_t>
+static double heap_workload(heap_t & heap, size_t ncells, double & popsum)
+{
+  unsigned int rnd(42);
+  double const t0(now());
+  for (size_t ii(0); ii < ncells; ++ii) {
+    rnd = rnd * 1103515245 + 12345;
+    heap.set(ii, 1000.0 * (rnd >> 8) / (1 << 24));
+  }
+  popsum = 0;
+  while ( ! heap.empty()) {
+    double const top(heap.topKey());
+    popsum += top;
+    heap.pop();
+    for (int ic(0); ic < 2; ++ic) {
+      rnd = rnd * 1103515245 + 12345;
+      size_t const index((rnd >> 4) % ncells);
+      if (heap.contains(index)) {
+	heap.set(index, top + 0.5 * (heap.at(0).key - top));
+      }
+    }
+  }
+  return now() - t0;
+}
+
+
+/** Binary versus 4- and 8-ary heaps. */
+static void bench_heap()
+{
+  printf("heap: set/pop/decrease-key on %zu cells, best of %d\n", dim * dim, repeat);
+  double best[3] = { -1, -1, -1 };
+  double sum[3] = { 0, 0, 0 };
+  for (int ir(0); ir < repeat; ++ir) {
+    DaryHeap<2> h2(dim * dim);
+    DaryHeap<4> h4(dim * dim);
+    DaryHeap<8> h8(dim * dim);
+    double tt[3];
+    tt[0] = heap_workload(h2, dim * dim, sum[0]);
+    tt[1] = heap_workload(h4, dim * dim, sum[1]);
+    tt[2] = heap_workload(h8, dim * dim, sum[2]);
+    for (int ih(0); ih < 3; ++ih) {
+      if ((best[ih] < 0) || (tt[ih] < best[ih])) {
+	best[ih] = tt[ih];
+      }
+    }
+  }
+  report("random", "binary heap", best[0], 0);
+  report("random", "4-ary heap", best[1], fabs(sum[1] - sum[0]));
+  report("random", "8-ary heap", best[2], fabs(sum[2] - sum[0]));
+}
+
+
+/** Serial compute() versus computeParallel() with 1, 2, 4, ... threads. */
+static void bench_parallel()
+{
+  printf("parallel: compute(infinity) versus computeParallel() with %zux%zu tiles"
+	 " on %zux%zu grids, best of %d, %ld cores online\n",
+	 tilesize, tilesize, dim, dim, repeat, sysconf(_SC_NPROCESSORS_ONLN));
+  for (map_s const * mm(maps); mm->name; ++mm) {
+    DistanceTransform serial(dim, dim, 1.0);
+    mm->setup(serial);
+    double best(-1);
+    for (int ir(0); ir < repeat; ++ir) {
+      serial.resetDist();
+      seed(serial);
+      double const t0(now());
+      serial.compute(DistanceTransform::infinity);
+      double const tt(now() - t0);
+      if ((best < 0) || (tt < best)) {
+	best = tt;
+      }
+    }
+    report(mm->name, "serial", best, 0);
+    
+    DistanceTransform parallel(dim, dim, 1.0);
+    mm->setup(parallel);
+    for (size_t nthreads(1); nthreads <= maxthreads; nthreads *= 2) {
+      best = -1;
+      size_t nrounds(0);
+      for (int ir(0); ir < repeat; ++ir) {
+	parallel.resetDist();
+	seed(parallel);
+	double const t0(now());
+	nrounds = parallel.computeParallel(nthreads, tilesize);
+	double const tt(now() - t0);
+	if ((best < 0) || (tt < best)) {
+	  best = tt;
+	}
+      }
+      char what[64];
+      snprintf(what, sizeof(what), "%zu threads (%zu rounds)", nthreads, nrounds);
+      report(mm->name, what, best, max_diff(serial, parallel));
+    }
+  }
+}
+
+
+typedef void (*bench_t)();
+
+static struct bench_s {
+  char const * name;
+  bench_t run;
+  char const * help;
+} const benchmarks[] = {
+  { "queue", bench_queue, "exact heap versus bucket queue" },
+  { "update", bench_update, "update() kernel and compute() throughput" },
+  { "layout", bench_layout, "split versus packed per-cell storage, in cache and DRAM" },
+  { "precision", bench_precision, "double versus float transforms" },
+  { "gradient", bench_gradient, "per-cell versus bulk gradient computation" },
+  { "sweep", bench_sweep, "fast marching versus fast sweeping" },
+  { "exact", bench_exact, "fast marching versus exact Euclidean transform" },
+  { "replan", bench_replan, "incremental repair after speed changes" },
+  { "ingest", bench_ingest, "per-cell versus bulk loading of speeds and seeds" },
+  { "reset", bench_reset, "cost of resetDist() after local and global queries" },
+  { "until", bench_until, "point-to-point queries with heuristic weights" },
+  { "budget", bench_budget, "time-sliced versus one-shot propagation" },
+  { "batch", bench_batch, "many goals on separate versus shared speed maps" },
+  { "label", bench_label, "nearest-source labels versus one transform per source" },
+  { "order", bench_order, "accuracy and cost of first- versus second-order stencils" },
+  { "voxel", bench_voxel, "2D versus 3D fast marching on similar cell counts" },
+  { "sparse", bench_sparse, "dense versus tiled storage, and bounded queries on huge grids" },
+  { "band", bench_band, "per-frame clearance layer, dense versus narrow band" },
+  { "signed", bench_signed, "one signed pass versus two unsigned transforms" },
+  { "heap", bench_heap, "binary versus d-ary indexed heaps" },
+  { "parallel", bench_parallel, "serial versus tiled multi-threaded fast marching" },
+  { 0, 0, 0 }
+};
+
+
+int main(int argc, char ** argv)
+{
+  vector<bench_s const *> selected;
+  for (int iopt(1); iopt < argc; ++iopt) {
+    string const opt(argv[iopt]);
+    if ("-n" == opt) {
+      ++iopt;
+      if (iopt >= argc) {
+	errx(EXIT_FAILURE, "-n requires an argument (use -h for some help)");
+      }
+      int nn;
+      if ((1 != sscanf(argv[iopt], "%d", &nn)) || (nn < 2)) {
+	errx(EXIT_FAILURE, "error reading dimension \"%s\"", argv[iopt]);
+      }
+      dim = nn;
+    }
+    else if ("-r" == opt) {
+      ++iopt;
+      if (iopt >= argc) {
+	errx(EXIT_FAILURE, "-r requires an argument (use -h for some help)");
+      }
+      if ((1 != sscanf(argv[iopt], "%d", &repeat)) || (repeat < 1)) {
+	errx(EXIT_FAILURE, "error reading repeat \"%s\"", argv[iopt]);
+      }
+    }
+    else if ("-t" == opt) {
+      ++iopt;
+      if (iopt >= argc) {
+	errx(EXIT_FAILURE, "-t requires an argument (use -h for some help)");
+      }
+      int nn;
+      if ((1 != sscanf(argv[iopt], "%d", &nn)) || (nn < 1)) {
+	errx(EXIT_FAILURE, "error reading number of threads \"%s\"", argv[iopt]);
+      }
+      maxthreads = nn;
+    }
+    else if ("-s" == opt) {
+      ++iopt;
+      if (iopt >= argc) {
+	errx(EXIT_FAILURE, "-s requires an argument (use -h for some help)");
+      }
+      int nn;
+      if ((1 != sscanf(argv[iopt], "%d", &nn)) || (nn < 1)) {
+	errx(EXIT_FAILURE, "error reading tile size \"%s\"", argv[iopt]);
+      }
+      tilesize = nn;
+    }
+    else if ("-h" == opt) {
+      printf("Distance transform benchmarks.\n"
+	     "\n"
+	     "usage [-n dim] [-r repeat] [-t threads] [-s tilesize] [-h] [benchmark ...]\n"
+	     "\n"
+	     "  -n  dim               grid dimension along X and Y (default %zu)\n"
+	     "  -r  repeat            number of runs, the best is reported (default %d)\n"
+	     "  -t  threads           maximum number of threads for parallel (default %zu)\n"
+	     "  -s  tilesize          tile size for parallel (default %zu)\n"
+	     "  -h                    this message\n"
+	     "\n"
+	     "Runs all benchmarks unless some are named on the command line:\n",
+	     dim, repeat, maxthreads, tilesize);
+      for (bench_s const * bb(benchmarks); bb->name; ++bb) {
+	printf("  %-20s  %s\n", bb->name, bb->help);
+      }
+      printf("\nRemember to build with optimization, e.g. make clean && make CXXFLAGS=-O2 bench\n");
+      exit(EXIT_SUCCESS);
+    }
+    else {
+      bench_s const * bb(benchmarks);
+      for (/**/; bb->name; ++bb) {
+	if (opt == bb->name) {
+	  break;
+	}
+      }
+      if ( ! bb->name) {
+	errx(EXIT_FAILURE, "invalid option or benchmark \"%s\" (use -h for some help)", argv[iopt]);
+      }
+      selected.push_back(bb);
+    }
+  }
+
+  if (selected.empty()) {
+    for (bench_s const * bb(benchmarks); bb->name; ++bb) {
+      selected.push_back(bb);
+    }
+  }
+  for (size_t ii(0); ii < selected.size(); ++ii) {
+    selected[ii]->run();
+  }
+}
@@ -264,8 +264,8 @@ static PyMethodDef dtrans_methods[] = {
     "  pass a speed smaller than zero or larger than one, it is ignored and this\n"
     "  method returns false.\n"
     "\n"
-    "  NOTE: you should set speeds before propagating the distance transform.\n"
-    "        dtrans does not support changing the speed on the fly.\n"
+    "  NOTE: you can change speeds after propagating the distance transform. Only\n"
+    "        the affected cells get requeued, call compute() again to repair them.\n"
     "\n"
     "  Returns True if the given speed and indices were valid, False otherwise."
   },
@@ -140,7 +140,9 @@ protected:
 	memset(&value[0], 0, value.size());
       }
       else {
-	vector<double>::const_iterator in(dt->valueArray().begin());
+	vector<double> dist;
+	dt->copyValues(dist);
+	vector<double>::const_iterator in(dist.begin());
 	vector<unsigned char>::iterator out(value.begin());
 	vector<unsigned char>::iterator end(value.end());
 	for (/**/; out != end; ++in, ++out) {
@@ -189,20 +191,18 @@ protected:
       gx.resize(dt->nCells());
       gy.resize(dt->nCells());
       count.resize(dt->nCells());
-      for (size_t ix(0); ix < dimx; ++ix) {
-	for (size_t iy(0); iy < dimy; ++iy) {
-	  size_t ixy(dt->index(ix, iy));
-	  double dgx, dgy;
-	  count[ixy] = dt->computeGradient(ix, iy, dgx, dgy);
-	  if (count[ixy] > 0) {
-	    double const len(sqrt(pow(dgx, 2) + pow(dgy, 2)));
-	    gx[ixy] = static_cast<int>(rint(dgx * skip / len));
-	    gy[ixy] = static_cast<int>(rint(dgy * skip / len));
-	  }
-	  else {
-	    gx[ixy] = 0;
-	    gy[ixy] = 0;
-	  }
+      vector<double> dgx(dt->nCells());
+      vector<double> dgy(dt->nCells());
+      dt->computeGradientField(&dgx[0], &dgy[0], &count[0]);
+      for (size_t ixy(0); ixy < count.size(); ++ixy) {
+	if (count[ixy] > 0) {
+	  double const len(sqrt(pow(dgx[ixy], 2) + pow(dgy[ixy], 2)));
+	  gx[ixy] = static_cast<int>(rint(dgx[ixy] * skip / len));
+	  gy[ixy] = static_cast<int>(rint(dgy[ixy] * skip / len));
+	}
+	else {
+	  gx[ixy] = 0;
+	  gy[ixy] = 0;
 	}
       }
     }
@@ -62,6 +62,7 @@ int main(int argc, char ** argv)
   int inthresh(0);
   float inscale(1.0/255);
   float ceiling(std::numeric_limits<float>::max());
+  bool euclidean(false);
   for (int iopt(1); iopt < argc; ++iopt) {
     string const opt(argv[iopt]);
     if ("-i" == opt) {
@@ -115,6 +116,9 @@ int main(int argc, char ** argv)
 	errx(EXIT_FAILURE, "error reading ceiling \"%s\"", argv[iopt]);
       }
     }
+    else if ("-e" == opt) {
+      euclidean = true;
+    }
     else if ("-v" == opt) {
       ++verbosity;
     }
@@ -128,7 +132,7 @@ int main(int argc, char ** argv)
       printf("Distance transform from estar.sf.net -- Copyright (c) 2010 Roland Philippsen.\n"
 	     "Redistribution, use, and modification permitted under the new BSD license.\n"
 	     "\n"
-	     "usage [-i infile] [-o outfile] [-s speedfile] [-tScvh]\n"
+	     "usage [-i infile] [-o outfile] [-s speedfile] [-tScevh]\n"
 	     "\n"
 	     "  -i  input file name   name of the distance map initialization file\n"
 	     "                        (use `-' for stdin, which is the default)\n"
@@ -141,6 +145,10 @@ int main(int argc, char ** argv)
 	     "                        (default scale %f = 1/255)\n"
 	     "  -c  outceil           ceiling for distance computation\n"
 	     "                        (default ceiling %g = max of float)\n"
+	     "  -e                    exact Euclidean distance, if all speeds are\n"
+	     "                        equal and all seeds have the same value\n"
+	     "                        (falls back to normal propagation otherwise,\n"
+	     "                        and ignores the ceiling)\n"
 	     "  -v                    verbose mode (multiple times makes it more verbose)\n"
 	     "  -h                    this message\n",
 	     1.0/255, std::numeric_limits<float>::max());
@@ -198,23 +206,35 @@ int main(int argc, char ** argv)
       }
     }
     
-    if (verbosity > 0) {
-      printf("propagating distance transform\n");
-    }
-    if (verbosity <= 2) {
-      dt->compute(ceiling);
+    if (euclidean) {
+      if (verbosity > 0) {
+	printf("computing exact Euclidean distance transform\n");
+      }
+      if ( ! dt->computeEuclidean()) {
+	warnx("map is not uniform, falling back to propagation"
+	      " (try -t 0 and no speed map for an exact transform)");
+	euclidean = false;
+      }
     }
-    else {
-      int step(0);
-      printf("step %d\n", step);
-      dt->dumpQueue(stdout, "  ");
-      while (dt->propagate()) {
-	if (dt->getTopKey() > ceiling) {
-	  printf("ceiling reached\n");
-	}
-	++step;
+    if ( ! euclidean) {
+      if (verbosity > 0) {
+	printf("propagating distance transform\n");
+      }
+      if (verbosity <= 2) {
+	dt->compute(ceiling);
+      }
+      else {
+	int step(0);
 	printf("step %d\n", step);
 	dt->dumpQueue(stdout, "  ");
+	while (dt->propagate()) {
+	  if (dt->getTopKey() > ceiling) {
+	    printf("ceiling reached\n");
+	  }
+	  ++step;
+	  printf("step %d\n", step);
+	  dt->dumpQueue(stdout, "  ");
+	}
       }
     }
     if (verbosity > 1) {
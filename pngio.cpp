@@ -119,24 +119,30 @@ namespace dtrans {
       throw runtime_error("dtrans::PNGIO::createTransform(): no data");
     }
     
-    DistanceTransform * dt(new DistanceTransform(width_, height_, 1));
-    
-    for (png_uint_32 irow(0); irow < height_; ++irow) {
-      png_bytep row(row_p_[irow]);
-      for (png_uint_32 icol(0); icol < width_; ++icol) {
-	if (invert) {
-	  if (row[icol] >= thresh) {
-	    dt->setDist(icol, height_ - irow - 1, (255 - row[icol]) * scale);
-	  }
+    // Translate gray values once, negative distances mean "no seed".
+    double lut[256];
+    for (int gray(0); gray < 256; ++gray) {
+      lut[gray] = -1;
+      if (invert) {
+	if (gray >= thresh) {
+	  lut[gray] = (255 - gray) * scale;
 	}
-	else {
-	  if (row[icol] <= thresh) {
-	    dt->setDist(icol, height_ - irow - 1, row[icol] * scale);
-	  }
+      }
+      else {
+	if (gray <= thresh) {
+	  lut[gray] = gray * scale;
 	}
       }
     }
     
+    DistanceTransform * dt(new DistanceTransform(width_, height_, 1));
+    
+    // PNG rows are stored top row first and not necessarily
+    // contiguously, so pass them one by one.
+    for (png_uint_32 irow(0); irow < height_; ++irow) {
+      dt->setDistBuffer(row_p_[irow], 0, lut, height_ - irow - 1, 1);
+    }
+    
     return dt;
   }
   
@@ -156,37 +162,38 @@ namespace dtrans {
       throw runtime_error(msg.str());
     }
     
-    for (png_uint_32 irow(0); irow < height_; ++irow) {
-      png_bytep row(row_p_[irow]);
-      for (png_uint_32 icol(0); icol < width_; ++icol) {
-	double speed(0);
-	if (invert) {
-	  if (row[icol] >= thresh) {
-	    speed = (255 - row[icol]) * scale;
-	  }
-	}
-	else {
-	  if (row[icol] <= thresh) {
-	    speed = row[icol] * scale;
-	  }
-	}
-	if (speed < 0) {
-	  speed = 0;
-	}
-	else if (speed > 1) {
-	  speed = 1;
+    double lut[256];
+    for (int gray(0); gray < 256; ++gray) {
+      double speed(0);
+      if (invert) {
+	if (gray >= thresh) {
+	  speed = (255 - gray) * scale;
 	}
-	if ( ! dt.setSpeed(icol, height_ - irow - 1, speed)) {
-	  std::ostringstream msg;
-	  msg << "dtrans::PNGIO::mapSpeed(): setSpeed() failed\n"
-	      << "  params: thresh " << thresh << "  scale " << scale
-	      << (invert ? "  invert TRUE\n" : "  invert FALSE\n")
-	      << "  dimensions: " << width_ << "x" << height_ << "\n"
-	      << "  index: (" << icol << ", " << height_ - irow - 1 << ")\n"
-	      << "  computation:  pixel " << row[icol] << "  speed " << speed;
-	  throw runtime_error(msg.str());
+      }
+      else {
+	if (gray <= thresh) {
+	  speed = gray * scale;
 	}
       }
+      if (speed < 0) {
+	speed = 0;
+      }
+      else if (speed > 1) {
+	speed = 1;
+      }
+      lut[gray] = speed;
+    }
+    
+    for (png_uint_32 irow(0); irow < height_; ++irow) {
+      if ( ! dt.setSpeedBuffer(row_p_[irow], 0, lut, height_ - irow - 1, 1)) {
+	std::ostringstream msg;
+	msg << "dtrans::PNGIO::mapSpeed(): setSpeedBuffer() failed\n"
+	    << "  params: thresh " << static_cast<int>(thresh) << "  scale " << scale
+	    << (invert ? "  invert TRUE\n" : "  invert FALSE\n")
+	    << "  dimensions: " << width_ << "x" << height_ << "\n"
+	    << "  row: " << height_ - irow - 1;
+	throw runtime_error(msg.str());
+      }
     }
   }
   
@@ -38,7 +38,9 @@
 
 namespace dtrans {
 
-  class DistanceTransform;
+  struct SplitCells;
+  template<typename Scalar, typename Cells> class BasicDistanceTransform;
+  typedef BasicDistanceTransform<double, SplitCells> DistanceTransform;
   
 
   /**
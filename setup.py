@@ -1,7 +1,8 @@
 from distutils.core import setup, Extension
 
 module = Extension('dtrans',
-                   sources = ['dtransmodule.cpp', 'DistanceTransform.cpp'])
+                   sources = ['dtransmodule.cpp', 'DistanceTransform.cpp'],
+                   libraries = ['pthread'])
 
 setup (name = 'DistanceTransform',
        version = '0.0',
@@ -30,8 +30,14 @@
  */
 
 #include "DistanceTransform.hpp"
+#include "DistanceTransform3D.hpp"
+#include "SparseDistanceTransform.hpp"
+#include "SignedDistanceTransform.hpp"
+#include "DaryHeap.hpp"
+#include "BucketQueue.hpp"
 #include <iostream>
 #include <stdio.h>
+#include <math.h>
 
 using namespace dtrans;
 using namespace std;
@@ -70,6 +76,1028 @@ int main(int argc, char ** argv)
   }
   dt.dump(stdout, "test4  ");
   
+  {
+    DistanceTransform march(20, 15, 0.1);
+    DistanceTransform sweep(20, 15, 0.1);
+    for (size_t ix(3); ix < 17; ++ix) {
+      march.setSpeed(ix, 7, 0.0);
+      sweep.setSpeed(ix, 7, 0.0);
+      march.setSpeed(ix, 10, 0.5);
+      sweep.setSpeed(ix, 10, 0.5);
+    }
+    march.setDist(10, 2, 0.0);
+    sweep.setDist(10, 2, 0.0);
+    march.compute(DistanceTransform::infinity);
+    size_t const nsweeps(sweep.computeSweep(0, 100));
+    if (nsweeps >= 100) {
+      ok = false;
+      cout << "sweep.computeSweep(0, 100) did not converge\n";
+    }
+    for (size_t ix(0); ix < 20; ++ix) {
+      for (size_t iy(0); iy < 15; ++iy) {
+	double const dm(march.getDist(ix, iy));
+	double const ds(sweep.getDist(ix, iy));
+	if ((dm != ds) && (fabs(dm - ds) > 1e-9)) {
+	  ok = false;
+	  cout << "sweep and march differ at (" << ix << ", " << iy << "): "
+	       << ds << " instead of " << dm << "\n";
+	}
+      }
+    }
+  }
+  
+  {
+    DistanceTransform serial(23, 17, 0.1);
+    DistanceTransform parallel(23, 17, 0.1);
+    for (size_t iy(2); iy < 15; ++iy) {
+      serial.setSpeed(11, iy, 0.0);
+      parallel.setSpeed(11, iy, 0.0);
+      serial.setSpeed(iy, 8, 0.3);
+      parallel.setSpeed(iy, 8, 0.3);
+    }
+    serial.setDist(5, 3, 0.0);
+    parallel.setDist(5, 3, 0.0);
+    serial.setDist(20, 14, 0.5);
+    parallel.setDist(20, 14, 0.5);
+    serial.compute(DistanceTransform::infinity);
+    parallel.computeParallel(3, 4);
+    for (size_t ix(0); ix < 23; ++ix) {
+      for (size_t iy(0); iy < 17; ++iy) {
+	double const ds(serial.getDist(ix, iy));
+	double const dp(parallel.getDist(ix, iy));
+	if ((ds != dp) && (fabs(ds - dp) > 1e-9)) {
+	  ok = false;
+	  cout << "parallel and serial differ at (" << ix << ", " << iy << "): "
+	       << dp << " instead of " << ds << "\n";
+	}
+      }
+    }
+  }
+  
+  {
+    DistanceTransform exact(19, 12, 0.5);
+    exact.setDist(4, 3, 1.0);
+    exact.setDist(15, 9, 1.0);
+    if ( ! exact.computeEuclidean()) {
+      ok = false;
+      cout << "exact.computeEuclidean() failed on a uniform map\n";
+    }
+    for (size_t ix(0); ix < 19; ++ix) {
+      for (size_t iy(0); iy < 12; ++iy) {
+	double const d1(hypot(ix - 4.0, iy - 3.0));
+	double const d2(hypot(ix - 15.0, iy - 9.0));
+	double const want(1.0 + 0.5 * (d1 < d2 ? d1 : d2));
+	if (fabs(exact.getDist(ix, iy) - want) > 1e-9) {
+	  ok = false;
+	  cout << "exact.getDist(" << ix << ", " << iy << ") should have returned "
+	       << want << " instead of " << exact.getDist(ix, iy) << "\n";
+	}
+      }
+    }
+    exact.setSpeed(7, 7, 0.5);
+    if (exact.computeEuclidean()) {
+      ok = false;
+      cout << "exact.computeEuclidean() should have failed on a non-uniform map\n";
+    }
+  }
+  
+  {
+    // add a wall and a slow patch after the fact, then take them
+    // away again, and compare with fresh computations
+    DistanceTransform inc(21, 16, 0.2);
+    inc.setDist(4, 5, 0.0);
+    inc.compute(DistanceTransform::infinity);
+    for (int pass(0); pass < 2; ++pass) {
+      double const wall(pass == 0 ? 0.0 : 1.0);
+      double const patch(pass == 0 ? 0.25 : 1.0);
+      for (size_t iy(1); iy < 13; ++iy) {
+	inc.setSpeed(9, iy, wall);
+      }
+      for (size_t ix(12); ix < 18; ++ix) {
+	inc.setSpeed(ix, 10, patch);
+	inc.setSpeed(ix, 11, patch);
+      }
+      inc.compute(DistanceTransform::infinity);
+      
+      DistanceTransform ref(21, 16, 0.2);
+      for (size_t iy(1); iy < 13; ++iy) {
+	ref.setSpeed(9, iy, wall);
+      }
+      for (size_t ix(12); ix < 18; ++ix) {
+	ref.setSpeed(ix, 10, patch);
+	ref.setSpeed(ix, 11, patch);
+      }
+      ref.setDist(4, 5, 0.0);
+      ref.compute(DistanceTransform::infinity);
+      for (size_t ix(0); ix < 21; ++ix) {
+	for (size_t iy(0); iy < 16; ++iy) {
+	  double const di(inc.getDist(ix, iy));
+	  double const dr(ref.getDist(ix, iy));
+	  if ((di != dr) && (fabs(di - dr) > 1e-9)) {
+	    ok = false;
+	    cout << "replanning pass " << pass << " differs at (" << ix << ", " << iy << "): "
+		 << di << " instead of " << dr << "\n";
+	  }
+	}
+      }
+    }
+  }
+  
+  {
+    // bulk setters versus one cell at a time, with the buffers
+    // stored top row first
+    float speed[6][7];
+    float dist[6][7];
+    for (size_t iy(0); iy < 6; ++iy) {
+      for (size_t ix(0); ix < 7; ++ix) {
+	speed[iy][ix] = ((ix + iy) % 4) / 3.0;
+	dist[iy][ix] = ((ix == 2 * iy) ? 0.1 * ix : -1);
+      }
+    }
+    speed[1][1] = 2.0;		// invalid, must be skipped
+    DistanceTransform bulk(7, 6, 0.3);
+    DistanceTransform cell(7, 6, 0.3);
+    if (bulk.setSpeedBuffer(&speed[5][0], -7)) {
+      ok = false;
+      cout << "bulk.setSpeedBuffer() should have reported the invalid speed\n";
+    }
+    bulk.setDistBuffer(&dist[5][0], -7);
+    for (size_t iy(0); iy < 6; ++iy) {
+      for (size_t ix(0); ix < 7; ++ix) {
+	cell.setSpeed(ix, iy, speed[5 - iy][ix]);
+	if (dist[5 - iy][ix] >= 0) {
+	  cell.setDist(ix, iy, dist[5 - iy][ix]);
+	}
+      }
+    }
+    bulk.compute(DistanceTransform::infinity);
+    cell.compute(DistanceTransform::infinity);
+    for (size_t ix(0); ix < 7; ++ix) {
+      for (size_t iy(0); iy < 6; ++iy) {
+	if (bulk.getDist(ix, iy) != cell.getDist(ix, iy)) {
+	  ok = false;
+	  cout << "bulk and per-cell setters differ at (" << ix << ", " << iy << "): "
+	       << bulk.getDist(ix, iy) << " instead of " << cell.getDist(ix, iy) << "\n";
+	}
+      }
+    }
+  }
+  
+  {
+    // a local query, a reset, and a full query must give the same
+    // result as a fresh instance
+    DistanceTransform reused(15, 11, 0.5);
+    DistanceTransform fresh(15, 11, 0.5);
+    reused.setDist(2, 2, 0.0);
+    reused.compute(1.2);
+    double gx, gy;
+    reused.computeGradient(3, 2, gx, gy);
+    reused.resetDist();
+    if (reused.getTopKey() < DistanceTransform::infinity) {
+      ok = false;
+      cout << "reused.resetDist() did not purge the queue\n";
+    }
+    reused.setDist(12, 8, 0.0);
+    fresh.setDist(12, 8, 0.0);
+    reused.compute(DistanceTransform::infinity);
+    fresh.compute(DistanceTransform::infinity);
+    for (size_t ix(0); ix < 15; ++ix) {
+      for (size_t iy(0); iy < 11; ++iy) {
+	if (reused.getDist(ix, iy) != fresh.getDist(ix, iy)) {
+	  ok = false;
+	  cout << "reused and fresh differ at (" << ix << ", " << iy << "): "
+	       << reused.getDist(ix, iy) << " instead of " << fresh.getDist(ix, iy) << "\n";
+	}
+      }
+    }
+  }
+  
+  {
+    // goal-directed queries: the target gets the same distance as
+    // with a full computation, or an upper bound with heuristic
+    // that a second call without heuristic makes final, and
+    // unreachable targets are reported as such
+    DistanceTransform full(20, 14, 1.0);
+    DistanceTransform until(20, 14, 1.0);
+    DistanceTransform astar(20, 14, 1.0);
+    for (size_t iy(0); iy < 10; ++iy) {
+      full.setSpeed(9, iy, 0);
+      until.setSpeed(9, iy, 0);
+      astar.setSpeed(9, iy, 0);
+    }
+    full.setDist(3, 2, 0.0);
+    until.setDist(3, 2, 0.0);
+    astar.setDist(3, 2, 0.0);
+    full.compute(DistanceTransform::infinity);
+    if (DistanceTransform::REACHED_FINAL != until.computeUntil(16, 3)) {
+      ok = false;
+      cout << "computeUntil() did not finalize its target\n";
+    }
+    if (until.getDist(16, 3) != full.getDist(16, 3)) {
+      ok = false;
+      cout << "computeUntil() gave " << until.getDist(16, 3)
+	   << " instead of " << full.getDist(16, 3) << "\n";
+    }
+    if (DistanceTransform::REACHED_UPPER_BOUND != astar.computeUntil(16, 3, 0.5)) {
+      ok = false;
+      cout << "computeUntil() with heuristic did not report an upper bound\n";
+    }
+    double const dd(astar.getDist(16, 3) - full.getDist(16, 3));
+    if ((dd < -1e-9) || (dd > 0.05 * full.getDist(16, 3))) {
+      ok = false;
+      cout << "computeUntil() with heuristic gave " << astar.getDist(16, 3)
+	   << " instead of about " << full.getDist(16, 3) << "\n";
+    }
+    if ((DistanceTransform::REACHED_FINAL != astar.computeUntil(16, 3))
+	|| (fabs(astar.getDist(16, 3) - full.getDist(16, 3)) > 1e-9)) {
+      ok = false;
+      cout << "computeUntil() after heuristic gave " << astar.getDist(16, 3)
+	   << " instead of " << full.getDist(16, 3) << "\n";
+    }
+    if (until.computeUntil(9, 5)) {
+      ok = false;
+      cout << "computeUntil() claims to have reached an obstacle\n";
+    }
+    DistanceTransform weighted(20, 14, 1.0);
+    weighted.setDist(3, 2, 0.0);
+    if (weighted.computeUntil(16, 3, 1.5) || weighted.computeUntil(16, 3, -0.5)
+	|| weighted.computeUntil(16, 3, sqrt(-1.0))
+	|| (weighted.getDist(4, 2) < DistanceTransform::infinity)) {
+      ok = false;
+      cout << "computeUntil() accepts heuristic weights outside [0, 1]\n";
+    }
+    astar.compute(DistanceTransform::infinity);
+    until.compute(DistanceTransform::infinity);
+    for (size_t ix(0); ix < 20; ++ix) {
+      for (size_t iy(0); iy < 14; ++iy) {
+	if ((until.getDist(ix, iy) != full.getDist(ix, iy))
+	    || (fabs(astar.getDist(ix, iy) - full.getDist(ix, iy)) > 1e-9)) {
+	  ok = false;
+	  cout << "computeUntil() followed by compute() differs at (" << ix << ", " << iy
+	       << "): " << until.getDist(ix, iy) << " and " << astar.getDist(ix, iy)
+	       << " instead of " << full.getDist(ix, iy) << "\n";
+	}
+      }
+    }
+  }
+  
+  {
+    // budgeted computation in small slices ends up like compute()
+    DistanceTransform full(13, 9, 1.0);
+    DistanceTransform sliced(13, 9, 1.0);
+    DistanceTransform timed(13, 9, 1.0);
+    full.setDist(4, 6, 0.0);
+    sliced.setDist(4, 6, 0.0);
+    timed.setDist(4, 6, 0.0);
+    full.compute(DistanceTransform::infinity);
+    size_t nslices(0);
+    for (;;) {
+      DistanceTransform::progress_s const pp(sliced.computeFor(7));
+      ++nslices;
+      if (pp.top_key != sliced.getTopKey()) {
+	ok = false;
+	cout << "computeFor() returned top key " << pp.top_key
+	     << " instead of " << sliced.getTopKey() << "\n";
+      }
+      if (pp.top_key >= DistanceTransform::infinity) {
+	break;
+      }
+      if (7 != pp.expansions) {
+	ok = false;
+	cout << "computeFor(7) did " << pp.expansions << " expansions\n";
+	break;
+      }
+    }
+    if (nslices < 2) {
+      ok = false;
+      cout << "computeFor(7) did everything in one go\n";
+    }
+    if (timed.computeForTime(60).top_key < DistanceTransform::infinity) {
+      ok = false;
+      cout << "computeForTime(60) did not finish a tiny grid\n";
+    }
+    for (size_t ix(0); ix < 13; ++ix) {
+      for (size_t iy(0); iy < 9; ++iy) {
+	if ((sliced.getDist(ix, iy) != full.getDist(ix, iy))
+	    || (timed.getDist(ix, iy) != full.getDist(ix, iy))) {
+	  ok = false;
+	  cout << "budgeted computation differs at (" << ix << ", " << iy << "): "
+	       << sliced.getDist(ix, iy) << " and " << timed.getDist(ix, iy)
+	       << " instead of " << full.getDist(ix, iy) << "\n";
+	}
+      }
+    }
+  }
+  
+  {
+    // several goals on one shared speed map, computed as a batch,
+    // give the same as separate transforms, and changing the speeds
+    // of one of them leaves the others alone
+    DistanceTransform proto(16, 12, 1.0);
+    for (size_t iy(2); iy < 12; ++iy) {
+      proto.setSpeed(7, iy, 0);
+    }
+    for (size_t ix(9); ix < 14; ++ix) {
+      proto.setSpeed(ix, 5, 0.3);
+    }
+    static size_t const ngoals(5);
+    vector<DistanceTransform*> batch;
+    for (size_t ig(0); ig < ngoals; ++ig) {
+      batch.push_back(new DistanceTransform(proto.speedMap()));
+      batch.back()->setDist(3 * ig, 2 * ig + 1, 0.0);
+    }
+    if (ngoals + 1 != proto.speedMap()->refCount()) {
+      ok = false;
+      cout << "speed map has " << proto.speedMap()->refCount() << " users instead of "
+	   << ngoals + 1 << "\n";
+    }
+    DistanceTransform::computeBatch(batch, 3);
+    for (size_t ig(0); ig < ngoals; ++ig) {
+      DistanceTransform single(16, 12, 1.0);
+      for (size_t iy(2); iy < 12; ++iy) {
+	single.setSpeed(7, iy, 0);
+      }
+      for (size_t ix(9); ix < 14; ++ix) {
+	single.setSpeed(ix, 5, 0.3);
+      }
+      single.setDist(3 * ig, 2 * ig + 1, 0.0);
+      single.compute(DistanceTransform::infinity);
+      for (size_t ix(0); ix < 16; ++ix) {
+	for (size_t iy(0); iy < 12; ++iy) {
+	  if (batch[ig]->getDist(ix, iy) != single.getDist(ix, iy)) {
+	    ok = false;
+	    cout << "batch goal " << ig << " differs at (" << ix << ", " << iy << "): "
+		 << batch[ig]->getDist(ix, iy) << " instead of " << single.getDist(ix, iy) << "\n";
+	  }
+	}
+      }
+    }
+    batch[0]->setSpeed(7, 4, 1.0);
+    if ((batch[0]->speedMap() == proto.speedMap())
+	|| (ngoals != proto.speedMap()->refCount())
+	|| (proto.speedMap()->radiusAt(proto.speedMap()->slot(7, 4)) < DistanceTransform::infinity)) {
+      ok = false;
+      cout << "setSpeed() on a shared speed map did not make a private copy\n";
+    }
+    for (size_t ig(0); ig < ngoals; ++ig) {
+      delete batch[ig];
+    }
+    if (1 != proto.speedMap()->refCount()) {
+      ok = false;
+      cout << "speed map still has " << proto.speedMap()->refCount() << " users\n";
+    }
+  }
+  
+  {
+    // labels give the closest source, except maybe right at the
+    // boundaries, with all engines
+    static size_t const dimx(21);
+    static size_t const dimy(15);
+    static size_t const nsrc(3);
+    static size_t const sx[] = { 2, 17, 9 };
+    static size_t const sy[] = { 3, 4, 12 };
+    vector<DistanceTransform*> single;
+    for (size_t is(0); is < nsrc; ++is) {
+      single.push_back(new DistanceTransform(dimx, dimy, 1.0));
+      single.back()->setDist(sx[is], sy[is], 0.0);
+      single.back()->compute(DistanceTransform::infinity);
+    }
+    for (int engine(0); engine < 4; ++engine) {
+      DistanceTransform dt(dimx, dimy, 1.0);
+      for (size_t is(0); is < nsrc; ++is) {
+	dt.setDist(sx[is], sy[is], 0.0, 10 + is);
+      }
+      char const * name;
+      switch (engine) {
+      case 0: name = "compute()"; dt.compute(DistanceTransform::infinity); break;
+      case 1: name = "computeSweep()"; dt.computeSweep(0, 100); break;
+      case 2: name = "computeParallel()"; dt.computeParallel(2, 6); break;
+      default: name = "computeEuclidean()"; dt.computeEuclidean();
+      }
+      for (size_t ix(0); ix < dimx; ++ix) {
+	for (size_t iy(0); iy < dimy; ++iy) {
+	  size_t best(0);
+	  for (size_t is(1); is < nsrc; ++is) {
+	    if (single[is]->getDist(ix, iy) < single[best]->getDist(ix, iy)) {
+	      best = is;
+	    }
+	  }
+	  size_t const label(dt.getLabel(ix, iy));
+	  if ((label < 10) || (label >= 10 + nsrc)) {
+	    ok = false;
+	    cout << name << " gave an invalid label " << label
+		 << " at (" << ix << ", " << iy << ")\n";
+	  }
+	  else if ((label != 10 + best)
+		   && (single[label - 10]->getDist(ix, iy) > single[best]->getDist(ix, iy) + 1)) {
+	    ok = false;
+	    cout << name << " gave label " << label << " instead of " << 10 + best
+		 << " at (" << ix << ", " << iy << ")\n";
+	  }
+	}
+      }
+    }
+    for (size_t is(0); is < nsrc; ++is) {
+      delete single[is];
+    }
+  }
+  
+  {
+    // the second-order stencil is much more accurate on a point
+    // source whose vicinity is seeded with exact distances, and it
+    // still copes with obstacles
+    static size_t const nn(41);
+    double const hh(1.0 / (nn - 1));
+    DistanceTransform first(nn, nn, hh);
+    DistanceTransform second(nn, nn, hh);
+    second.setStencil(DistanceTransform::SECOND_ORDER);
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	double const dd(hypot(ix * hh - 0.5, iy * hh - 0.5));
+	if (dd <= 0.1) {
+	  first.setDist(ix, iy, dd);
+	  second.setDist(ix, iy, dd);
+	}
+      }
+    }
+    first.compute(DistanceTransform::infinity);
+    second.compute(DistanceTransform::infinity);
+    double err1(0);
+    double err2(0);
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	double const dd(hypot(ix * hh - 0.5, iy * hh - 0.5));
+	if (fabs(first.getDist(ix, iy) - dd) > err1) {
+	  err1 = fabs(first.getDist(ix, iy) - dd);
+	}
+	if (fabs(second.getDist(ix, iy) - dd) > err2) {
+	  err2 = fabs(second.getDist(ix, iy) - dd);
+	}
+      }
+    }
+    if ( ! (err2 < err1 / 4)) {
+      ok = false;
+      cout << "second-order error " << err2 << " is not much below first-order error "
+	   << err1 << "\n";
+    }
+    
+    DistanceTransform walled(nn, nn, hh);
+    walled.setStencil(DistanceTransform::SECOND_ORDER);
+    for (size_t iy(0); iy < nn - 5; ++iy) {
+      walled.setSpeed(nn / 2, iy, 0);
+    }
+    walled.setDist(5, 5, 0);
+    walled.compute(DistanceTransform::infinity);
+    double const around(walled.getDist(nn - 6, 5));
+    if ( ! ((around > 2 * (nn - 10) * hh) && (around < DistanceTransform::infinity))) {
+      ok = false;
+      cout << "second-order distance around a wall is " << around << "\n";
+    }
+  }
+  
+  {
+    // voxel grids: a single slab matches the 2D transform, a point
+    // source lies between the Euclidean distance and its first-order
+    // overestimate, and adding a wall after propagating gives the
+    // same result as having it from the start
+    static size_t const nn(21);
+    DistanceTransform flat(nn, nn, 1);
+    DistanceTransform3D slab(nn, nn, 1, 1);
+    flat.setDist(3, 4, 0);
+    slab.setDist(3, 4, 0, 0);
+    flat.compute(DistanceTransform::infinity);
+    slab.compute(DistanceTransform3D::infinity);
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	if (fabs(flat.getDist(ix, iy) - slab.getDist(ix, iy, 0)) > 1e-9) {
+	  ok = false;
+	  cout << "3D slab gives " << slab.getDist(ix, iy, 0) << " instead of "
+	       << flat.getDist(ix, iy) << " at (" << ix << ", " << iy << ")\n";
+	}
+      }
+    }
+    
+    DistanceTransform3D cube(nn, nn, nn, 1);
+    DistanceTransform3D walled(nn, nn, nn, 1);
+    cube.setDist(nn / 2, nn / 2, nn / 2, 0);
+    walled.setDist(nn / 2, nn / 2, nn / 2, 0);
+    cube.compute(DistanceTransform3D::infinity);
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	for (size_t iz(0); iz < nn; ++iz) {
+	  double const dx(static_cast<double>(ix) - nn / 2);
+	  double const dy(static_cast<double>(iy) - nn / 2);
+	  double const dz(static_cast<double>(iz) - nn / 2);
+	  double const dd(sqrt(dx * dx + dy * dy + dz * dz));
+	  double const dist(cube.getDist(ix, iy, iz));
+	  if ((dist < dd - 1e-9) || (dist > 1.1 * dd + 0.5)) {
+	    ok = false;
+	    cout << "3D distance " << dist << " too far from " << dd
+		 << " at (" << ix << ", " << iy << ", " << iz << ")\n";
+	  }
+	}
+      }
+    }
+    double gx, gy, gz;
+    if ((3 != cube.computeGradient(nn - 1, 0, 2, gx, gy, gz))
+	|| (gx <= 0) || (gy >= 0) || (gz >= 0)) {
+      ok = false;
+      cout << "3D gradient (" << gx << ", " << gy << ", " << gz << ") points the wrong way\n";
+    }
+    
+    for (size_t ix(0); ix < nn - 3; ++ix) {
+      for (size_t iy(2); iy < nn; ++iy) {
+	cube.setSpeed(ix, iy, nn / 2 + 2, 0);
+	walled.setSpeed(ix, iy, nn / 2 + 2, 0);
+      }
+    }
+    cube.compute(DistanceTransform3D::infinity);
+    walled.compute(DistanceTransform3D::infinity);
+    if (cube.valueArray() != walled.valueArray()) {
+      ok = false;
+      cout << "3D repair after adding a wall differs from computing from scratch\n";
+    }
+    if ( ! (cube.getDist(0, nn - 1, nn - 1) > cube.getDist(0, nn - 1, 0) + 2)) {
+      ok = false;
+      cout << "3D wall does not lengthen the distance behind it\n";
+    }
+  }
+  
+  {
+    // the tiled backend gives the same distances as the dense one,
+    // also after repairs, only allocates the tiles it reaches, and
+    // survives resetSpeed() with cells still queued
+    static size_t const nx(150);
+    static size_t const ny(100);
+    DistanceTransform dense(nx, ny, 1);
+    SparseDistanceTransform sparse(nx, ny, 1);
+    for (size_t iy(10); iy < ny; ++iy) {
+      dense.setSpeed(70, iy, 0);
+      sparse.setSpeed(70, iy, 0);
+    }
+    dense.setDist(5, 90, 0);
+    sparse.setDist(5, 90, 0);
+    dense.compute(DistanceTransform::infinity);
+    sparse.compute(SparseDistanceTransform::infinity);
+    for (size_t ix(0); ix < 5; ++ix) {
+      dense.setSpeed(ix + 60, 10, 0.25);
+      sparse.setSpeed(ix + 60, 10, 0.25);
+    }
+    dense.compute(DistanceTransform::infinity);
+    sparse.compute(SparseDistanceTransform::infinity);
+    for (size_t ix(0); ix < nx; ++ix) {
+      for (size_t iy(0); iy < ny; ++iy) {
+	if (dense.getDist(ix, iy) != sparse.getDist(ix, iy)) {
+	  ok = false;
+	  cout << "sparse transform gives " << sparse.getDist(ix, iy) << " instead of "
+	       << dense.getDist(ix, iy) << " at (" << ix << ", " << iy << ")\n";
+	}
+      }
+    }
+    
+    SparseDistanceTransform huge(50000, 50000, 1);
+    huge.setDist(30000, 20000, 0);
+    huge.compute(100);
+    size_t const span(2 * 100 / SparseDistanceTransform::tilesize + 3);
+    if ((huge.nTiles() > span * span) || (huge.getDist(30000, 20100) != 100)) {
+      ok = false;
+      cout << "sparse transform allocated " << huge.nTiles() << " tiles for a radius of 100\n";
+    }
+    huge.resetDist();
+    if (0 != huge.nTiles()) {
+      ok = false;
+      cout << "sparse transform kept " << huge.nTiles() << " tiles after resetDist()\n";
+    }
+    
+    // resetSpeed() in the middle of a computation releases the tiles
+    // beyond the wall, which still have queued cells
+    SparseDistanceTransform halted(128, 64, 1);
+    halted.setDist(62, 32, 0);
+    halted.compute(10);
+    for (size_t iy(0); iy < 64; ++iy) {
+      halted.setSpeed(63, iy, 0);
+    }
+    halted.resetSpeed();
+    halted.getTopKey();
+    halted.compute(SparseDistanceTransform::infinity);
+    if (halted.getDist(62, 20) != 12) {
+      ok = false;
+      cout << "sparse transform gives " << halted.getDist(62, 20)
+	   << " after resetSpeed() during a computation\n";
+    }
+  }
+  
+  {
+    // a narrow band keeps the distances inside it, stores nothing
+    // beyond it, and recomputing after resetDist() does not allocate
+    static size_t const nn(400);
+    SparseDistanceTransform full(nn, nn, 1);
+    SparseDistanceTransform banded(nn, nn, 1);
+    banded.setBand(5);
+    for (size_t ii(0); ii < 4; ++ii) {
+      full.setDist(50 + 90 * ii, 30 + 70 * ii, 0);
+      banded.setDist(50 + 90 * ii, 30 + 70 * ii, 0);
+    }
+    full.compute(SparseDistanceTransform::infinity);
+    banded.compute(SparseDistanceTransform::infinity);
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	double const want(full.getDist(ix, iy) <= 5 ? full.getDist(ix, iy)
+			  : SparseDistanceTransform::infinity);
+	if (banded.getDist(ix, iy) != want) {
+	  ok = false;
+	  cout << "narrow band gives " << banded.getDist(ix, iy) << " instead of " << want
+	       << " at (" << ix << ", " << iy << ")\n";
+	}
+      }
+    }
+    size_t const memory(banded.memoryUsage());
+    if ((banded.nTiles() > 16) || (banded.nTiles() >= full.nTiles())) {
+      ok = false;
+      cout << "narrow band uses " << banded.nTiles() << " tiles\n";
+    }
+    banded.resetDist();
+    banded.setDist(60, 40, 0);
+    banded.compute(SparseDistanceTransform::infinity);
+    if ((banded.memoryUsage() != memory) || (banded.getDist(60, 45) != 5)) {
+      ok = false;
+      cout << "narrow band recomputation went from " << memory << " to "
+	   << banded.memoryUsage() << " bytes\n";
+    }
+  }
+  
+  {
+    // one signed pass over a disk gives, on each side, what an
+    // unsigned transform gives with the other side as obstacle, and
+    // its gradient points outward on both sides
+    static size_t const nn(41);
+    SignedDistanceTransform sdt(nn, nn, 0.5);
+    DistanceTransform outside(nn, nn, 0.5);
+    DistanceTransform inside(nn, nn, 0.5);
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	bool const in(hypot(ix - 20.0, iy - 17.0) < 11);
+	sdt.setInside(ix, iy, in);
+	(in ? outside : inside).setSpeed(ix, iy, 0);
+      }
+    }
+    size_t const nseeds(sdt.seedBoundary());
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	if (0.25 == fabs(sdt.getDist(ix, iy))) {
+	  (sdt.isInside(ix, iy) ? inside : outside).setDist(ix, iy, 0.25);
+	}
+      }
+    }
+    sdt.compute(SignedDistanceTransform::infinity);
+    inside.compute(DistanceTransform::infinity);
+    outside.compute(DistanceTransform::infinity);
+    if (nseeds < 4 * 2 * 11) {
+      ok = false;
+      cout << "signed transform seeded only " << nseeds << " boundary cells\n";
+    }
+    for (size_t ix(0); ix < nn; ++ix) {
+      for (size_t iy(0); iy < nn; ++iy) {
+	double const want(sdt.isInside(ix, iy) ? -inside.getDist(ix, iy) : outside.getDist(ix, iy));
+	if (sdt.getDist(ix, iy) != want) {
+	  ok = false;
+	  cout << "signed transform gives " << sdt.getDist(ix, iy) << " instead of " << want
+	       << " at (" << ix << ", " << iy << ")\n";
+	}
+      }
+    }
+    double gx, gy;
+    sdt.computeGradient(27, 17, gx, gy);
+    double hx, hy;
+    sdt.computeGradient(35, 17, hx, hy);
+    if ((gx <= 0) || (hx <= 0) || (sdt.getDist(27, 17) >= 0) || (sdt.getDist(35, 17) <= 0)) {
+      ok = false;
+      cout << "signed gradient " << gx << " inside and " << hx << " outside do not point outward\n";
+    }
+  }
+  
+  {
+    // the bucket queue stays within one bucket width above the exact
+    // queue, expanding each cell once, for narrow and wide buckets,
+    // on an open field and in rooms connected by doors, and buckets
+    // wider than the scale are refused
+    static size_t const dimx(83);
+    static size_t const dimy(67);
+    static double const width[] = { 0.01, 0.03, 0.05, 0.1, 0.0 };
+    for (size_t imap(0); imap < 2; ++imap) {
+      DistanceTransform exact(dimx, dimy, 0.1);
+      if (1 == imap) {
+	for (size_t iy(0); iy < dimy; ++iy) {
+	  for (size_t ix(0); ix < dimx; ++ix) {
+	    bool const wall((0 == ix % 16) || (0 == iy % 16));
+	    bool const door((((ix % 16) >= 5 + (iy / 16) % 7) && ((ix % 16) < 8 + (iy / 16) % 7))
+			    || (((iy % 16) >= 3 + (ix / 16) % 9) && ((iy % 16) < 6 + (ix / 16) % 9)));
+	    if (wall && ! door) {
+	      exact.setSpeed(ix, iy, 0.0);
+	    }
+	  }
+	}
+      }
+      exact.setDist(29, 23, 0.0);
+      exact.compute(DistanceTransform::infinity);
+      for (size_t iw(0); width[iw] > 0; ++iw) {
+	DistanceTransform bucketed(exact.speedMap());
+	if (bucketed.setQueuePolicy(DistanceTransform::BUCKET_QUEUE, 0.11)
+	    || ! bucketed.setQueuePolicy(DistanceTransform::BUCKET_QUEUE, width[iw])) {
+	  ok = false;
+	  cout << "setQueuePolicy() got the range of bucket widths wrong\n";
+	}
+	bucketed.setDist(29, 23, 0.0);
+	size_t nexpanded(0);
+	while (bucketed.propagate()) {
+	  ++nexpanded;
+	}
+	if (nexpanded > dimx * dimy) {
+	  ok = false;
+	  cout << "bucket width " << width[iw] << " on map " << imap << " takes "
+	       << nexpanded << " expansions\n";
+	}
+	for (size_t ix(0); ix < dimx; ++ix) {
+	  for (size_t iy(0); iy < dimy; ++iy) {
+	    double const de(exact.getDist(ix, iy));
+	    double const db(bucketed.getDist(ix, iy));
+	    if ((de < DistanceTransform::infinity)
+		? ((db < de - 1e-9) || (db > de + width[iw])) : (db < de)) {
+	      ok = false;
+	      cout << "bucket width " << width[iw] << " on map " << imap << " gives " << db
+		   << " instead of " << de << " at (" << ix << ", " << iy << ")\n";
+	    }
+	  }
+	}
+      }
+    }
+  }
+  
+  {
+    // the bucket queue pops keys in order up to the bucket width,
+    // also when most of them start out beyond its window and when
+    // some get lowered below it or removed
+    static size_t const nn(500);
+    BucketQueue bq;
+    bq.reset(nn, 0.5, 8);
+    for (size_t ii(0); ii < nn; ++ii) {
+      bq.set(ii, (ii * 37) % nn + 100.0);
+    }
+    for (size_t ii(0); ii < nn; ii += 3) {
+      bq.set(ii, (ii * 53) % nn * 0.1);
+    }
+    for (size_t ii(1); ii < nn; ii += 7) {
+      bq.remove(ii);
+    }
+    size_t const nleft(bq.size());
+    size_t npopped(0);
+    double prev(0);
+    for (/**/; ! bq.empty(); ++npopped) {
+      if (bq.topKey() < prev - bq.width()) {
+	ok = false;
+	cout << "bucket queue pops " << bq.topKey() << " after " << prev << "\n";
+      }
+      if (bq.topKey() > prev) {
+	prev = bq.topKey();
+      }
+      bq.pop();
+    }
+    if ((nleft != nn - (nn + 5) / 7) || (npopped != nleft)) {
+      ok = false;
+      cout << "bucket queue holds " << nleft << " and pops " << npopped << " elements\n";
+    }
+  }
+  
+  {
+    // d-ary heaps of any arity and order pop their keys sorted, also
+    // after changing and removing some of them, and after being
+    // filled in batches
+    static size_t const nn(100);
+    DaryHeap<4> minheap(nn);
+    DaryHeap<3, std::greater<double> > maxheap(nn);
+    for (size_t ii(0); ii < nn; ++ii) {
+      minheap.set(ii, (ii * 37) % nn);
+      maxheap.set(ii, (ii * 37) % nn);
+    }
+    for (size_t ii(0); ii < nn; ii += 3) {
+      minheap.set(ii, (ii * 53) % nn - 50.0);
+      maxheap.set(ii, (ii * 53) % nn - 50.0);
+    }
+    for (size_t ii(1); ii < nn; ii += 7) {
+      minheap.remove(ii);
+      maxheap.remove(ii);
+    }
+    size_t const nleft(minheap.size());
+    double prev(-DistanceTransform::infinity);
+    while ( ! minheap.empty()) {
+      if (minheap.topKey() < prev) {
+	ok = false;
+	cout << "4-ary min heap pops " << minheap.topKey() << " after " << prev << "\n";
+      }
+      prev = minheap.topKey();
+      minheap.pop();
+    }
+    size_t npopped(0);
+    prev = DistanceTransform::infinity;
+    for (/**/; ! maxheap.empty(); ++npopped) {
+      if (maxheap.topKey() > prev) {
+	ok = false;
+	cout << "3-ary max heap pops " << maxheap.topKey() << " after " << prev << "\n";
+      }
+      prev = maxheap.topKey();
+      maxheap.pop();
+    }
+    if ((nleft != nn - (nn + 5) / 7) || (npopped != nleft)) {
+      ok = false;
+      cout << "d-ary heaps hold " << nleft << " and " << npopped << " elements after removals\n";
+    }
+    // filled in batches of every size, as by per-row bulk setters
+    DaryHeap<4> batched(nn);
+    for (size_t ii(0), batch(1); ii < nn; ++batch) {
+      size_t const first(batched.size());
+      for (size_t jj(0); (jj < batch) && (ii < nn); ++jj, ++ii) {
+	batched.append(ii, (ii * 37) % nn);
+      }
+      batched.heapifyTail(first);
+    }
+    prev = -DistanceTransform::infinity;
+    for (npopped = 0; ! batched.empty(); ++npopped) {
+      if (batched.topKey() < prev) {
+	ok = false;
+	cout << "batched 4-ary heap pops " << batched.topKey() << " after " << prev << "\n";
+      }
+      prev = batched.topKey();
+      batched.pop();
+    }
+    if (npopped != nn) {
+      ok = false;
+      cout << "batched 4-ary heap pops " << npopped << " instead of " << nn << " elements\n";
+    }
+  }
+  
+  {
+    // packed cell records give bit-identical results to the split
+    // arrays, also when sharing the speed map of a split transform
+    // and vice versa
+    DistanceTransform split(23, 17, 0.1);
+    for (size_t iy(2); iy < 15; ++iy) {
+      split.setSpeed(11, iy, 0.0);
+      split.setSpeed(iy, 8, 0.3);
+    }
+    split.setDist(5, 3, 0.0, 1);
+    split.setDist(20, 14, 0.5, 2);
+    PackedDistanceTransform packed(split.speedMap());
+    packed.setDist(5, 3, 0.0, 1);
+    packed.setDist(20, 14, 0.5, 2);
+    PackedDistanceTransform shared(split.speedMap());
+    shared.setDist(5, 3, 0.0, 1);
+    shared.setDist(20, 14, 0.5, 2);
+    split.compute(DistanceTransform::infinity);
+    packed.compute(DistanceTransform::infinity);
+    shared.computeParallel(3, 4);
+    vector<double> vsplit, vpacked, vshared;
+    vector<size_t> lsplit, lpacked;
+    split.copyValues(vsplit);
+    packed.copyValues(vpacked);
+    shared.copyValues(vshared);
+    split.copyLabels(lsplit);
+    packed.copyLabels(lpacked);
+    if ((vpacked != vsplit) || (lpacked != lsplit) || (vshared != vsplit) || lsplit.empty()) {
+      ok = false;
+      cout << "packed cells differ from split arrays\n";
+    }
+    if ((split.valueArray() != vsplit) || (packed.labelArray() != lpacked)) {
+      ok = false;
+      cout << "valueArray() or labelArray() differ from copyValues() or copyLabels()\n";
+    }
+    split.setSpeed(11, 9, 1.0);
+    packed.setSpeed(11, 9, 1.0);
+    split.compute(DistanceTransform::infinity);
+    packed.compute(DistanceTransform::infinity);
+    split.copyValues(vsplit);
+    packed.copyValues(vpacked);
+    if (vpacked != vsplit) {
+      ok = false;
+      cout << "packed cells differ from split arrays after a repair\n";
+    }
+    // the other way around: a split transform on the map of a packed
+    // one, which leaves out the squares of the radii
+    PackedDistanceTransform owner(23, 17, 0.1);
+    for (size_t iy(2); iy < 15; ++iy) {
+      owner.setSpeed(11, iy, 0.0);
+      owner.setSpeed(iy, 8, 0.3);
+    }
+    owner.setSpeed(11, 9, 1.0);
+    owner.setDist(5, 3, 0.0, 1);
+    owner.setDist(20, 14, 0.5, 2);
+    DistanceTransform borrower(owner.speedMap());
+    borrower.setDist(5, 3, 0.0, 1);
+    borrower.setDist(20, 14, 0.5, 2);
+    owner.compute(DistanceTransform::infinity);
+    borrower.compute(DistanceTransform::infinity);
+    owner.copyValues(vpacked);
+    borrower.copyValues(vshared);
+    if ((vpacked != vsplit) || (vshared != vsplit)) {
+      ok = false;
+      cout << "split transform on a packed speed map differs\n";
+    }
+  }
+  
+  {
+    // single precision stays within a few float roundings of double,
+    // and cells that are walled off stay at its own infinity
+    DistanceTransform full(41, 29, 0.1);
+    FloatDistanceTransform single(41, 29, 0.1);
+    for (size_t iy(0); iy < 29; ++iy) {
+      for (size_t ix(0); ix < 41; ++ix) {
+	double const speed((ix == 30) ? 0.0 : 0.3 + 0.7 * ((ix * 7 + iy * 3) % 10) / 9.0);
+	full.setSpeed(ix, iy, speed);
+	single.setSpeed(ix, iy, speed);
+      }
+    }
+    full.setDist(3, 4, 0.0);
+    single.setDist(3, 4, 0.0);
+    full.compute(DistanceTransform::infinity);
+    single.compute(DistanceTransform::infinity);
+    for (size_t ix(0); ix < 41; ++ix) {
+      for (size_t iy(0); iy < 29; ++iy) {
+	double const dd(full.getDist(ix, iy));
+	double const ds(single.getDist(ix, iy));
+	if (ix >= 30) {
+	  if (ds < FloatDistanceTransform::infinity) {
+	    ok = false;
+	    cout << "float transform reaches walled-off cell (" << ix << ", " << iy << ")\n";
+	  }
+	}
+	else if (fabs(dd - ds) > 1e-5 * dd) {
+	  ok = false;
+	  cout << "float transform gives " << ds << " instead of " << dd
+	       << " at (" << ix << ", " << iy << ")\n";
+	}
+      }
+    }
+  }
+  
+  {
+    // the bulk gradient matches the per-cell one for the whole grid
+    // and for rectangles that touch each edge, around obstacles and
+    // seeds, and refuses rectangles that stick out of the grid
+    static size_t const dimx(19);
+    static size_t const dimy(13);
+    DistanceTransform dt(dimx, dimy, 0.1);
+    for (size_t iy(0); iy < 9; ++iy) {
+      dt.setSpeed(7, iy, 0.0);
+      dt.setSpeed(12, iy + 4, 0.5);
+    }
+    dt.setSpeed(0, 6, 0.0);
+    dt.setDist(3, 2, 0.0);
+    dt.setDist(15, 0, 0.3);
+    dt.setDist(10, 11, 2.0);
+    dt.compute(DistanceTransform::infinity);
+    static size_t const rect[][4] = {
+      { 0, 0, dimx, dimy },
+      { 0, 3, 5, 4 },		// west
+      { dimx - 4, 2, 4, 6 },	// east
+      { 5, 0, 8, 3 },		// south
+      { 2, dimy - 3, 9, 3 },	// north
+      { dimx - 1, dimy - 1, 1, 1 },
+      { 0, 0, 0, 0 }
+    };
+    for (size_t ir(0); rect[ir][2] > 0; ++ir) {
+      size_t const x0(rect[ir][0]);
+      size_t const y0(rect[ir][1]);
+      size_t const nx(rect[ir][2]);
+      size_t const ny(rect[ir][3]);
+      vector<double> gx(nx * ny);
+      vector<double> gy(nx * ny);
+      vector<size_t> count(nx * ny);
+      if ( ! dt.computeGradientField(x0, y0, nx, ny, &gx[0], &gy[0], &count[0])) {
+	ok = false;
+	cout << "computeGradientField(" << x0 << ", " << y0 << ", " << nx << ", " << ny << ") failed\n";
+	continue;
+      }
+      for (size_t iy(y0); iy < y0 + ny; ++iy) {
+	for (size_t ix(x0); ix < x0 + nx; ++ix) {
+	  double hx, hy;
+	  size_t const nn(dt.computeGradient(ix, iy, hx, hy));
+	  size_t const ii((iy - y0) * nx + (ix - x0));
+	  if ((nn != count[ii]) || (hx != gx[ii]) || (hy != gy[ii])) {
+	    ok = false;
+	    cout << "bulk gradient at (" << ix << ", " << iy << ") is (" << gx[ii] << ", " << gy[ii]
+		 << ") from " << count[ii] << " instead of (" << hx << ", " << hy << ") from " << nn << "\n";
+	  }
+	}
+      }
+    }
+    double gx, gy;
+    size_t count;
+    if (dt.computeGradientField(dimx - 2, 0, 3, 1, &gx, &gy, &count)
+	|| dt.computeGradientField(0, dimy, 1, 1, &gx, &gy, &count)) {
+      ok = false;
+      cout << "computeGradientField() accepts a rectangle outside the grid\n";
+    }
+  }
+  
   if (ok) {
     cout << "SUCCESS\n";
     return 0;
@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2012 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/*
+  Header-only d-ary heap of handles (small integers such as grid cell
+  indices) with double keys. It is the compile-time counterpart of
+  heap_t: instead of calling a key comparison function through a
+  pointer, each flavor of heap gets its own set of functions with the
+  comparison inlined. Keys and handles are interleaved in one array,
+  so moving an element touches one cache line instead of two, and the
+  array starts at index 0.
+  
+  Instantiate it by defining DHEAP_NAME (the prefix of the generated
+  functions) and DHEAP_BEFORE(lhs, rhs) (true if lhs belongs above
+  rhs), and optionally DHEAP_ARITY (defaults to 4), then including
+  this header. The parameters are undefined afterwards, so the header
+  can be included again for another flavor:
+  
+    #define DHEAP_NAME minq
+    #define DHEAP_BEFORE(lhs, rhs) ((lhs) < (rhs))
+    #include "dheap.h"
+  
+  generates minq_insert, minq_set, minq_pop, and minq_remove, which
+  all work on the common dheap_t created with dheap_create.
+*/
+
+#ifndef DTRANS_DHEAP_H
+#define DTRANS_DHEAP_H
+
+#include <stdlib.h>
+
+
+typedef struct dheap_entry_s {
+  double key;
+  size_t handle;
+} dheap_entry_t;
+
+
+/**
+   Heap data structure object. If it was created with nhandles > 0,
+   it keeps track of where each handle sits, so that changing its key
+   or removing it takes O(log n). Each handle can then be on the heap
+   at most once. With nhandles == 0 there is no such bookkeeping, and
+   only insert and pop can be used (e.g. for small scratch heaps).
+*/
+typedef struct dheap_s {
+  dheap_entry_t * entry;	/* first element at entry[0] */
+  size_t capacity;
+  size_t length;
+  size_t * pos;		/* handle to array index plus one (zero if not on heap), or NULL */
+  size_t nhandles;
+} dheap_t;
+
+
+#define DHEAP_LENGTH(heap) ((heap)->length)
+#define DHEAP_EMPTY(heap) ((heap)->length == 0)
+
+/**
+   Peek at the top of the heap. These macros do not check whether
+   the heap actually contains elements.
+*/
+#define DHEAP_PEEK_KEY(heap) ((heap)->entry[0].key)
+#define DHEAP_PEEK_HANDLE(heap) ((heap)->entry[0].handle)
+
+#define DHEAP_CAT_(prefix, name) prefix ## _ ## name
+#define DHEAP_CAT(prefix, name) DHEAP_CAT_(prefix, name)
+
+
+/**
+   Create a heap for handles in the range [0, nhandles). Pass
+   nhandles=0 for a heap without position tracking. It is an error to
+   pass capacity=0.
+   
+   \return A freshly created heap, or NULL in case of failure (which
+   stems from calloc, so you can use errno to get a system error
+   message).
+*/
+static inline dheap_t * dheap_create (size_t capacity, size_t nhandles)
+{
+  dheap_t * heap;
+  if ( ! (heap = calloc (1, sizeof(dheap_t)))) {
+    return NULL;
+  }
+  if ( ! (heap->entry = calloc (capacity, sizeof(dheap_entry_t)))) {
+    free (heap);
+    return NULL;
+  }
+  if (nhandles > 0) {
+    if ( ! (heap->pos = calloc (nhandles, sizeof(size_t)))) {
+      free (heap->entry);
+      free (heap);
+      return NULL;
+    }
+  }
+  heap->capacity = capacity;
+  heap->nhandles = nhandles;
+  return heap;
+}
+
+
+static inline void dheap_destroy (dheap_t * heap)
+{
+  free (heap->pos);
+  free (heap->entry);
+  free (heap);
+}
+
+
+/**
+   Make room for one more element, doubling the capacity if needed.
+   
+   \return 0 on success, -1 on failure (which stems from realloc, so
+   you can use errno to get a system error message).
+*/
+static inline int dheap_reserve (dheap_t * heap)
+{
+  dheap_entry_t * entry;
+  if (heap->length < heap->capacity) {
+    return 0;
+  }
+  if ( ! (entry = realloc (heap->entry, 2 * heap->capacity * sizeof(dheap_entry_t)))) {
+    return -1;
+  }
+  heap->entry = entry;
+  heap->capacity *= 2;
+  return 0;
+}
+
+
+/**
+   \return Nonzero if the handle is currently on a heap with position
+   tracking.
+*/
+static inline int dheap_contains (dheap_t const * heap, size_t handle)
+{
+  return (handle < heap->nhandles) && (0 != heap->pos[handle]);
+}
+
+
+/**
+   Remove all elements.
+*/
+static inline void dheap_clear (dheap_t * heap)
+{
+  size_t ii;
+  if (heap->pos) {
+    for (ii = 0; ii < heap->length; ++ii) {
+      heap->pos[heap->entry[ii].handle] = 0;
+    }
+  }
+  heap->length = 0;
+}
+
+#endif /* DTRANS_DHEAP_H */
+
+
+#ifdef DHEAP_NAME
+
+#ifndef DHEAP_BEFORE
+# error "define DHEAP_BEFORE(lhs, rhs) before including dheap.h"
+#endif
+
+#ifndef DHEAP_ARITY
+# define DHEAP_ARITY 4
+#endif
+
+
+/* Move a hole at the given slot towards the root until the key fits,
+   then store the element there. */
+static inline void DHEAP_CAT(DHEAP_NAME, sift_up) (dheap_t * heap, size_t slot,
+						  double key, size_t handle)
+{
+  size_t parent;
+  while (slot > 0) {
+    parent = (slot - 1) / DHEAP_ARITY;
+    if ( ! DHEAP_BEFORE (key, heap->entry[parent].key)) {
+      break;
+    }
+    heap->entry[slot] = heap->entry[parent];
+    if (heap->pos) {
+      heap->pos[heap->entry[slot].handle] = slot + 1;
+    }
+    slot = parent;
+  }
+  heap->entry[slot].key = key;
+  heap->entry[slot].handle = handle;
+  if (heap->pos) {
+    heap->pos[handle] = slot + 1;
+  }
+}
+
+
+/* Move a hole at the given slot towards the leaves until the key
+   fits, then store the element there. */
+static inline void DHEAP_CAT(DHEAP_NAME, sift_down) (dheap_t * heap, size_t slot,
+						    double key, size_t handle)
+{
+  size_t first, end, child, cc;
+  for (;;) {
+    first = DHEAP_ARITY * slot + 1;
+    if (first >= heap->length) {
+      break;
+    }
+    end = (heap->length - first > DHEAP_ARITY) ? first + DHEAP_ARITY : heap->length;
+    child = first;
+    for (cc = first + 1; cc < end; ++cc) {
+      if (DHEAP_BEFORE (heap->entry[cc].key, heap->entry[child].key)) {
+	child = cc;
+      }
+    }
+    if ( ! DHEAP_BEFORE (heap->entry[child].key, key)) {
+      break;
+    }
+    heap->entry[slot] = heap->entry[child];
+    if (heap->pos) {
+      heap->pos[heap->entry[slot].handle] = slot + 1;
+    }
+    slot = child;
+  }
+  heap->entry[slot].key = key;
+  heap->entry[slot].handle = handle;
+  if (heap->pos) {
+    heap->pos[handle] = slot + 1;
+  }
+}
+
+
+/**
+   Insert a handle.
+   
+   \return 0 on success, -1 if the heap could not grow, -2 if the
+   heap tracks positions and the handle is out of range or already on
+   the heap.
+*/
+static inline int DHEAP_CAT(DHEAP_NAME, insert) (dheap_t * heap, double key, size_t handle)
+{
+  if (heap->pos && ((handle >= heap->nhandles) || (0 != heap->pos[handle]))) {
+    return -2;
+  }
+  if (0 != dheap_reserve (heap)) {
+    return -1;
+  }
+  ++heap->length;
+  DHEAP_CAT(DHEAP_NAME, sift_up) (heap, heap->length - 1, key, handle);
+  return 0;
+}
+
+
+/**
+   Insert a handle, or change its key if it is already on the
+   heap. Requires position tracking.
+   
+   \return 0 on success, -1 if the heap could not grow, -2 if the
+   handle is out of range.
+*/
+static inline int DHEAP_CAT(DHEAP_NAME, set) (dheap_t * heap, size_t handle, double key)
+{
+  size_t slot;
+  if (handle >= heap->nhandles) {
+    return -2;
+  }
+  if (0 == heap->pos[handle]) {
+    return DHEAP_CAT(DHEAP_NAME, insert) (heap, key, handle);
+  }
+  slot = heap->pos[handle] - 1;
+  if (DHEAP_BEFORE (key, heap->entry[slot].key)) {
+    DHEAP_CAT(DHEAP_NAME, sift_up) (heap, slot, key, handle);
+  }
+  else {
+    DHEAP_CAT(DHEAP_NAME, sift_down) (heap, slot, key, handle);
+  }
+  return 0;
+}
+
+
+/**
+   Remove the top element. Does not check for an empty heap.
+   
+   \return The handle that used to be on top.
+*/
+static inline size_t DHEAP_CAT(DHEAP_NAME, pop) (dheap_t * heap)
+{
+  size_t const handle = heap->entry[0].handle;
+  dheap_entry_t last;
+  if (heap->pos) {
+    heap->pos[handle] = 0;
+  }
+  last = heap->entry[--heap->length];
+  if (0 != heap->length) {
+    DHEAP_CAT(DHEAP_NAME, sift_down) (heap, 0, last.key, last.handle);
+  }
+  return handle;
+}
+
+
+/**
+   Remove a handle from a heap with position tracking.
+   
+   \return 0 on success, -1 if the handle was not on the heap.
+*/
+static inline int DHEAP_CAT(DHEAP_NAME, remove) (dheap_t * heap, size_t handle)
+{
+  size_t slot;
+  dheap_entry_t last;
+  if ( ! dheap_contains (heap, handle)) {
+    return -1;
+  }
+  slot = heap->pos[handle] - 1;
+  heap->pos[handle] = 0;
+  last = heap->entry[--heap->length];
+  if (slot < heap->length) {
+    if (DHEAP_BEFORE (last.key, heap->entry[slot].key)) {
+      DHEAP_CAT(DHEAP_NAME, sift_up) (heap, slot, last.key, last.handle);
+    }
+    else {
+      DHEAP_CAT(DHEAP_NAME, sift_down) (heap, slot, last.key, last.handle);
+    }
+  }
+  return 0;
+}
+
+#undef DHEAP_NAME
+#undef DHEAP_BEFORE
+#undef DHEAP_ARITY
+
+#endif /* DHEAP_NAME */
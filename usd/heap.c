@@ -72,12 +72,36 @@ heap_t * heap_create (size_t capacity, heap_keycmp_t keycmp)
 }
 
 
+heap_t * heap_create_indexed (size_t capacity, heap_keycmp_t keycmp, size_t nhandles)
+{
+  heap_t * heap;
+  if ( ! (heap = heap_create (capacity, keycmp))) {
+    return NULL;
+  }
+  if ( ! (heap->pos = calloc (nhandles, sizeof(size_t)))) {
+    heap_destroy (heap);
+    return NULL;
+  }
+  heap->nhandles = nhandles;
+  return heap;
+}
+
+
 heap_t * heap_clone (heap_t * heap)
 {
   heap_t * clone;
-  if ( ! (clone = heap_create (heap->length, heap->keycmp))) {
+  if (heap->pos) {
+    clone = heap_create_indexed (heap->length, heap->keycmp, heap->nhandles);
+  }
+  else {
+    clone = heap_create (heap->length, heap->keycmp);
+  }
+  if ( ! clone) {
     return NULL;
   }
+  if (heap->pos) {
+    memcpy (clone->pos, heap->pos, heap->nhandles * sizeof(size_t));
+  }
   clone->length = heap->length;
   memcpy (clone->key + 1, heap->key + 1, heap->length * sizeof(double));
   memcpy (clone->value + 1, heap->value + 1, heap->length * sizeof(void*));
@@ -97,8 +121,21 @@ heap_t * minheap_create (size_t capacity)
 }
 
 
+heap_t * maxheap_create_indexed (size_t capacity, size_t nhandles)
+{
+  return heap_create_indexed (capacity, heap_keycmp_more, nhandles);
+}
+
+
+heap_t * minheap_create_indexed (size_t capacity, size_t nhandles)
+{
+  return heap_create_indexed (capacity, heap_keycmp_less, nhandles);
+}
+
+
 void heap_destroy (heap_t * heap)
 {
+  free (heap->pos);
   free (heap->value);
   free (heap->key);
   free (heap);
@@ -135,6 +172,10 @@ void heap_swap (heap_t * heap, size_t ii, size_t jj)
   heap->value[ii] = heap->value[jj];
   heap->key[jj] = kk;
   heap->value[jj] = vv;
+  if (heap->pos) {
+    heap->pos[(size_t) heap->value[ii]] = ii;
+    heap->pos[(size_t) vv] = jj;
+  }
 }
 
 
@@ -154,6 +195,9 @@ void heap_bubble_up (heap_t * heap, size_t index)
 
 int heap_insert (heap_t * heap, double key, const void * value)
 {
+  if (heap->pos && ((size_t) value >= heap->nhandles)) {
+    return -1;
+  }
   if (heap->length == heap->capacity) {
     if (0 != heap_grow (heap)) {
       return -1;
@@ -162,6 +206,9 @@ int heap_insert (heap_t * heap, double key, const void * value)
   ++heap->length; /* remember, arrays start at index 1 to simplify arithmetic */
   heap->key[heap->length] = key;
   heap->value[heap->length] = value;
+  if (heap->pos) {
+    heap->pos[(size_t) value] = heap->length;
+  }
   heap_bubble_up (heap, heap->length);
   return 0;
 }
@@ -200,7 +247,15 @@ int heap_change_key (heap_t * heap, double old_key, double new_key, const void *
 {
   size_t index;
   
-  index = heap_find_element (heap, old_key, value, 1);
+  if (heap->pos) {
+    index = ((size_t) value < heap->nhandles) ? heap->pos[(size_t) value] : 0;
+    if ((0 != index) && (heap->key[index] != old_key)) {
+      index = 0;
+    }
+  }
+  else {
+    index = heap_find_element (heap, old_key, value, 1);
+  }
   if (0 == index) {
     return -1;			/* no such element */
   }
@@ -274,6 +329,12 @@ void * heap_pop (heap_t * heap)
   heap->key[1] = heap->key[heap->length];
   heap->value[1] = heap->value[heap->length];
   --heap->length;
+  if (heap->pos) {
+    heap->pos[(size_t) vv] = 0;
+    if (heap->length > 0) {
+      heap->pos[(size_t) heap->value[1]] = 1;
+    }
+  }
   heap_bubble_down (heap, 1);
   return (void*) vv;
 }
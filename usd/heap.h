@@ -54,6 +54,12 @@ typedef double (*heap_keycmp_t)(double, double);
    the HEAP_PEEK_KEY and HEAP_PEEK_VALUE macros for convenience, but
    they do not check whether the heap actually contains elements. Use
    HEAP_LENGTH or HEAP_EMPTY in case of doubt.
+   
+   Heaps created with minheap_create_indexed or maxheap_create_indexed
+   additionally keep track of where each value sits in the array. In
+   that case, values have to be small integers (handles, such as grid
+   cell indices) cast to void*, and heap_change_key takes O(log n)
+   instead of searching the tree.
 */
 typedef struct heap_s {
   heap_keycmp_t keycmp;
@@ -61,6 +67,8 @@ typedef struct heap_s {
   const void ** value;
   size_t capacity;
   size_t length;
+  size_t * pos; /* handle to array index (zero if not on heap), or NULL */
+  size_t nhandles;
 } heap_t;
 
 
@@ -114,6 +122,16 @@ double heap_keycmp_less (double lhs, double rhs);
 */
 heap_t * heap_create (size_t capacity, heap_keycmp_t keycmp);
 
+/**
+   Internal function for creating an indexed heap, see
+   minheap_create_indexed and maxheap_create_indexed.
+   
+   \return A freshly created heap, or NULL in case of failure (which
+   stems from calloc, so you can use errno to get a system error
+   message).
+*/
+heap_t * heap_create_indexed (size_t capacity, heap_keycmp_t keycmp, size_t nhandles);
+
 /**
    Create a clone of a given heap. The capacity of the clone will be
    exactly the length of the original.
@@ -144,6 +162,28 @@ heap_t * maxheap_create (size_t capacity);
 */
 heap_t * minheap_create (size_t capacity);
 
+/**
+   Create a max heap whose values are handles in the range
+   [0, nhandles), with O(log n) heap_change_key. Each handle can be
+   on the heap at most once.
+   
+   \return A freshly created max heap, or NULL in case of failure
+   (which stems from calloc, so you can use errno to get a system
+   error message).
+*/
+heap_t * maxheap_create_indexed (size_t capacity, size_t nhandles);
+
+/**
+   Create a min heap whose values are handles in the range
+   [0, nhandles), with O(log n) heap_change_key. Each handle can be
+   on the heap at most once.
+   
+   \return A freshly created min heap, or NULL in case of failure
+   (which stems from calloc, so you can use errno to get a system
+   error message).
+*/
+heap_t * minheap_create_indexed (size_t capacity, size_t nhandles);
+
 /**
    Destroy a heap. Properly frees any memory allocated by the heap,
    but you are still responsible for freeing up, if applicable, any of
@@ -178,7 +218,8 @@ void heap_bubble_up (heap_t * heap, size_t index);
    heap or a max heap.
    
    \return 0 on success, or -1 on failure (which stems from a failed
-   heap_grow, thus from realloc, and thus you can use errno).
+   heap_grow, thus from realloc, and thus you can use errno, or from
+   passing a handle that is out of range to an indexed heap).
 */
 int heap_insert (heap_t * heap, double key, const void * value);
 
@@ -203,7 +244,8 @@ size_t heap_find_element (heap_t * heap, double key, const void * value, size_t
    \note Both the old_key and the value have to match, and the
    implementation uses a straightforward pointer comparison on the
    value. So beware of heaps that store strings or similar possibly
-   identical duplicates for the value.
+   identical duplicates for the value. Indexed heaps look up the
+   element by its handle instead of searching for it.
    
    \return 0 on success, -1 if the given key-value pair is not in the
    heap, and -2 if there is some problem detecting whether this is a
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2012 Roland Philippsen <roland DOT philippsen AT gmx DOT net>
+ *
+ * BSD license:
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holder nor the names of
+ *    contributors to this software may be used to endorse or promote
+ *    products derived from this software without specific prior written
+ *    permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHORS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED
+ * TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT
+ * HOLDER OR THE CONTRIBUTORS TO THIS SOFTWARE BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "heap.h"
+
+#define DHEAP_NAME minq2
+#define DHEAP_BEFORE(lhs, rhs) ((lhs) < (rhs))
+#define DHEAP_ARITY 2
+#include "dheap.h"
+
+#define DHEAP_NAME minq4
+#define DHEAP_BEFORE(lhs, rhs) ((lhs) < (rhs))
+#include "dheap.h"
+
+#include <stdio.h>
+#include <err.h>
+#include <sys/time.h>
+
+
+/*
+  Microbenchmark for heap_change_key on big heaps: the plain heap
+  has to search the tree for the element, the indexed heap looks up
+  its position. Keys get decreased by random amounts, as in fast
+  marching. Usage: heap_bench [nelements [nplain]], where nplain is
+  the number of changes done on the plain heap (it is slow).
+  
+  The same is then done with the binary and 4-ary flavors of the
+  header-only dheap, followed by popping everything off the heap.
+*/
+
+
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+static unsigned int rnd_state = 42;
+
+static double rnd (void)
+{
+  rnd_state = rnd_state * 1103515245 + 12345;
+  return (rnd_state >> 8) / (double) (1 << 24);
+}
+
+
+static double run (heap_t * heap, double * key, size_t nn, size_t nchanges)
+{
+  size_t ii, handle;
+  double t0, newkey;
+  
+  rnd_state = 42;
+  for (ii = 0; ii < nn; ++ii) {
+    key[ii] = 1000.0 * rnd ();
+    if (0 != heap_insert (heap, key[ii], (void*) ii)) {
+      errx (EXIT_FAILURE, "heap_insert failed");
+    }
+  }
+  
+  t0 = now ();
+  for (ii = 0; ii < nchanges; ++ii) {
+    handle = (size_t) (nn * rnd ()) % nn;
+    newkey = key[handle] * rnd ();
+    if (0 != heap_change_key (heap, key[handle], newkey, (void*) handle)) {
+      errx (EXIT_FAILURE, "heap_change_key failed");
+    }
+    key[handle] = newkey;
+  }
+  return now () - t0;
+}
+
+
+/* Time the key changes and, separately, emptying the heap. The
+   functions are passed in because each dheap flavor has its own. */
+static void run_dheap (char const * name, dheap_t * heap, double * key, size_t nn,
+		       int (*set)(dheap_t *, size_t, double),
+		       size_t (*pop)(dheap_t *))
+{
+  size_t ii, handle;
+  double t0, dt, newkey;
+  
+  rnd_state = 42;
+  for (ii = 0; ii < nn; ++ii) {
+    key[ii] = 1000.0 * rnd ();
+    if (0 != set (heap, ii, key[ii])) {
+      errx (EXIT_FAILURE, "%s_set failed", name);
+    }
+  }
+  
+  t0 = now ();
+  for (ii = 0; ii < nn; ++ii) {
+    handle = (size_t) (nn * rnd ()) % nn;
+    newkey = key[handle] * rnd ();
+    set (heap, handle, newkey);
+    key[handle] = newkey;
+  }
+  dt = now () - t0;
+  printf ("  %-8s %8zu changes %9.4f s %12.3f us/change\n", name, nn, dt, 1e6 * dt / nn);
+  
+  t0 = now ();
+  while ( ! DHEAP_EMPTY (heap)) {
+    pop (heap);
+  }
+  dt = now () - t0;
+  printf ("  %-8s %8zu pops    %9.4f s %12.3f us/pop\n", name, nn, dt, 1e6 * dt / nn);
+}
+
+
+int main (int argc, char ** argv)
+{
+  size_t nn, nplain, nindexed;
+  double * key;
+  heap_t * heap;
+  dheap_t * dheap;
+  double t0, dt;
+  
+  nn = 1000000;
+  nplain = 200;
+  if ((argc > 1) && (1 != sscanf (argv[1], "%zu", &nn))) {
+    errx (EXIT_FAILURE, "invalid nelements %s", argv[1]);
+  }
+  if ((argc > 2) && (1 != sscanf (argv[2], "%zu", &nplain))) {
+    errx (EXIT_FAILURE, "invalid nplain %s", argv[2]);
+  }
+  nindexed = nn;
+  if ( ! (key = calloc (nn, sizeof(double)))) {
+    err (EXIT_FAILURE, "calloc");
+  }
+  
+  printf ("heap_change_key on min heaps of %zu elements\n", nn);
+  
+  if ( ! (heap = minheap_create (nn))) {
+    err (EXIT_FAILURE, "minheap_create");
+  }
+  dt = run (heap, key, nn, nplain);
+  printf ("  plain    %8zu changes %9.4f s %12.3f us/change\n", nplain, dt, 1e6 * dt / nplain);
+  heap_destroy (heap);
+  
+  if ( ! (heap = minheap_create_indexed (nn, nn))) {
+    err (EXIT_FAILURE, "minheap_create_indexed");
+  }
+  dt = run (heap, key, nn, nindexed);
+  printf ("  indexed  %8zu changes %9.4f s %12.3f us/change\n", nindexed, dt, 1e6 * dt / nindexed);
+  heap_destroy (heap);
+  
+  if ( ! (heap = minheap_create_indexed (nn, nn))) {
+    err (EXIT_FAILURE, "minheap_create_indexed");
+  }
+  run (heap, key, nn, 0);
+  t0 = now ();
+  while ( ! HEAP_EMPTY (heap)) {
+    heap_pop (heap);
+  }
+  dt = now () - t0;
+  printf ("  indexed  %8zu pops    %9.4f s %12.3f us/pop\n", nn, dt, 1e6 * dt / nn);
+  heap_destroy (heap);
+  
+  if ( ! (dheap = dheap_create (nn, nn))) {
+    err (EXIT_FAILURE, "dheap_create");
+  }
+  run_dheap ("dheap 2", dheap, key, nn, minq2_set, minq2_pop);
+  run_dheap ("dheap 4", dheap, key, nn, minq4_set, minq4_pop);
+  dheap_destroy (dheap);
+  
+  free (key);
+  return 0;
+}
@@ -30,6 +30,15 @@
  */
 
 #include "heap.h"
+
+#define DHEAP_NAME minq
+#define DHEAP_BEFORE(lhs, rhs) ((lhs) < (rhs))
+#include "dheap.h"
+
+#define DHEAP_NAME maxq3
+#define DHEAP_BEFORE(lhs, rhs) ((lhs) > (rhs))
+#define DHEAP_ARITY 3
+#include "dheap.h"
 #include <stdio.h>
 #include <err.h>
 
@@ -129,6 +138,131 @@ static int suite (heap_t * (*creator)(size_t))
 }
 
 
+static int suite_indexed (heap_t * (*creator)(size_t, size_t))
+{
+  static double keys[] = { 12.0, -13.0, 42.9, 7.5, 0.0 };
+  static const size_t nkeys = sizeof(keys) / sizeof(*keys);
+  heap_t * heap, * clone;
+  size_t ii, handle;
+  double prev;
+  
+  if (NULL == (heap = creator (2, nkeys))) {
+    fprintf (stderr, "OOPS: creation failed\n");
+    return -1;
+  }
+  for (ii = 0; ii < nkeys; ++ii) {
+    heap_insert (heap, keys[ii], (void*) ii);
+  }
+  if (0 == heap_insert (heap, 1.0, (void*) nkeys)) {
+    fprintf (stderr, "OOPS: handle out of range should have failed!\n");
+    return -2;
+  }
+  for (ii = 1; ii <= heap->length; ++ii) {
+    if (heap->pos[(size_t) heap->value[ii]] != ii) {
+      fprintf (stderr, "OOPS: position of handle %zu is wrong\n", (size_t) heap->value[ii]);
+      return -3;
+    }
+  }
+  
+  fprintf (stderr, "\nlet's modify some existing and bogus elements...\n");
+  if (0 != heap_change_key (heap, keys[3], -99.0, (void*) 3)) {
+    fprintf (stderr, "OOPS: that should have succeeded!\n");
+    return -4;
+  }
+  if (0 != heap_change_key (heap, keys[1], 99.0, (void*) 1)) {
+    fprintf (stderr, "OOPS: that should have succeeded!\n");
+    return -5;
+  }
+  if (0 == heap_change_key (heap, 888.999, -1.0, (void*) 0)) {
+    fprintf (stderr, "OOPS: invalid old_key should have failed!\n");
+    return -6;
+  }
+  
+  clone = heap_clone (heap);
+  fprintf (stderr, "\nafter changing keys:\n");
+  for (ii = 0; 0 != clone->length; ++ii) {
+    prev = HEAP_PEEK_KEY (clone);
+    handle = (size_t) heap_pop (clone);
+    fprintf (stderr, "% 5.2f\thandle %zu\n", prev, handle);
+    if (0 != clone->pos[handle]) {
+      fprintf (stderr, "OOPS: popped handle %zu still has a position\n", handle);
+      return -7;
+    }
+    if ((0 != clone->length) && (clone->keycmp (HEAP_PEEK_KEY (clone), prev) > 0.0)) {
+      fprintf (stderr, "OOPS: elements came out in the wrong order\n");
+      return -8;
+    }
+  }
+  if (ii != nkeys) {
+    fprintf (stderr, "OOPS: popped %zu instead of %zu elements\n", ii, nkeys);
+    return -9;
+  }
+  
+  heap_destroy (clone);
+  heap_destroy (heap);
+  return 0;
+}
+
+
+static int suite_dheap (const char * name,
+			int (*set)(dheap_t *, size_t, double),
+			int (*remove)(dheap_t *, size_t),
+			size_t (*pop)(dheap_t *),
+			double sign)
+{
+  static const size_t nn = 100;
+  dheap_t * heap;
+  size_t ii, npopped;
+  double prev;
+  
+  if (NULL == (heap = dheap_create (2, nn))) {
+    fprintf (stderr, "OOPS: %s creation failed\n", name);
+    return -1;
+  }
+  for (ii = 0; ii < nn; ++ii) {
+    set (heap, ii, (double) ((ii * 37) % nn));
+  }
+  if (0 == set (heap, nn, 1.0)) {
+    fprintf (stderr, "OOPS: %s handle out of range should have failed!\n", name);
+    return -2;
+  }
+  for (ii = 0; ii < nn; ii += 3) {
+    set (heap, ii, (double) ((ii * 53) % nn) - 50.0);
+  }
+  for (ii = 1; ii < nn; ii += 7) {
+    if (0 != remove (heap, ii)) {
+      fprintf (stderr, "OOPS: %s failed to remove handle %zu\n", name, ii);
+      return -3;
+    }
+  }
+  if (0 == remove (heap, 1)) {
+    fprintf (stderr, "OOPS: %s removing twice should have failed!\n", name);
+    return -4;
+  }
+  
+  for (npopped = 0; ! DHEAP_EMPTY (heap); ++npopped) {
+    prev = DHEAP_PEEK_KEY (heap);
+    ii = pop (heap);
+    if (dheap_contains (heap, ii)) {
+      fprintf (stderr, "OOPS: %s popped handle %zu is still on the heap\n", name, ii);
+      return -5;
+    }
+    if ( ! DHEAP_EMPTY (heap) && (sign * (DHEAP_PEEK_KEY (heap) - prev) < 0.0)) {
+      fprintf (stderr, "OOPS: %s elements came out in the wrong order\n", name);
+      return -6;
+    }
+  }
+  if (npopped != nn - (nn + 5) / 7) {
+    fprintf (stderr, "OOPS: %s popped %zu elements\n", name, npopped);
+    return -7;
+  }
+  fprintf (stderr, "%s: %zu elements came out in order\n", name, npopped);
+  
+  dheap_destroy (heap);
+  return 0;
+}
+
+
 int main (int argc, char ** argv)
 {
   size_t nfail;
@@ -144,6 +278,24 @@ int main (int argc, char ** argv)
     ++nfail;
   }
   
+  fprintf (stderr, "\nindexed max heap...\n\n");
+  if (0 != suite_indexed (maxheap_create_indexed)) {
+    ++nfail;
+  }
+  
+  fprintf (stderr, "\nindexed min heap...\n\n");
+  if (0 != suite_indexed (minheap_create_indexed)) {
+    ++nfail;
+  }
+  
+  fprintf (stderr, "\nd-ary heaps...\n\n");
+  if (0 != suite_dheap ("4-ary min heap", minq_set, minq_remove, minq_pop, 1.0)) {
+    ++nfail;
+  }
+  if (0 != suite_dheap ("3-ary max heap", maxq3_set, maxq3_remove, maxq3_pop, -1.0)) {
+    ++nfail;
+  }
+  
   if (nfail == 1) {
     fprintf (stderr, "\nOOPS there was a failure\n");
     return 1;
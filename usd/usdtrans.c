@@ -29,11 +29,13 @@
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "heap.h"
 #include <math.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <err.h>
+#include <pthread.h>
+#include <sys/time.h>
 
 
 #define USDTRANS_INFINITY 1.0e9
@@ -43,13 +45,31 @@
 #define USDTRANS_FLAG_QUEUE_POSITIVE 0x04
 #define USDTRANS_FLAG_QUEUE_NEGATIVE 0x08
 
+#define DHEAP_NAME minq
+#define DHEAP_BEFORE(lhs, rhs) ((lhs) < (rhs))
+#include "dheap.h"
 
+#define DHEAP_NAME maxq
+#define DHEAP_BEFORE(lhs, rhs) ((lhs) > (rhs))
+#include "dheap.h"
+
+
+/*
+  The side of a cell is +1 or -1 for the positive or negative part of
+  the partition, and 0 for seeds. It never changes during
+  propagation, and each side only ever looks at cells of its own
+  side and at seeds. That is what allows usdtrans_compute_concurrent
+  to run both sides at the same time: the only cells they share are
+  the seeds, which nobody writes to once propagation has started.
+*/
 typedef struct usdtrans_s {
   double * dist;
   int * flags;
-  heap_t * queue_positive;
-  heap_t * queue_negative;
-  heap_t * propagators;
+  signed char * side;
+  dheap_t * queue_positive;
+  dheap_t * queue_negative;
+  dheap_t * propagators_positive;
+  dheap_t * propagators_negative;
   size_t dimx, dimy, ncells, toprow, rightcol;
 } usdtrans_t;
 
@@ -70,14 +90,23 @@ usdtrans_t * usdtrans_create (size_t dimx, size_t dimy)
   if ( ! (usd->flags = calloc (ncells, sizeof(int)))) {
     goto fail_flags;
   }
-  if ( ! (usd->queue_positive = maxheap_create (dimx + dimy))) {
+  if ( ! (usd->side = calloc (ncells, sizeof(signed char)))) {
+    goto fail_side;
+  }
+  /* positive distances grow away from the interface, negative ones
+     shrink, so the positive side needs a min heap and the negative
+     side a max heap */
+  if ( ! (usd->queue_positive = dheap_create (dimx + dimy, ncells))) {
     goto fail_qp;
   }
-  if ( ! (usd->queue_negative = minheap_create (dimx + dimy))) {
+  if ( ! (usd->queue_negative = dheap_create (dimx + dimy, ncells))) {
     goto fail_qn;
   }
-  if ( ! (usd->propagators = minheap_create (4))) {
-    goto fail_props;
+  if ( ! (usd->propagators_positive = dheap_create (4, 0))) {
+    goto fail_pp;
+  }
+  if ( ! (usd->propagators_negative = dheap_create (4, 0))) {
+    goto fail_pn;
   }
   
   usd->dimx = dimx;
@@ -88,14 +117,19 @@ usdtrans_t * usdtrans_create (size_t dimx, size_t dimy)
   for (ii = 0; ii < ncells; ++ii) {
     usd->dist[ii] = USDTRANS_INFINITY;
     usd->flags[ii] = USDTRANS_FLAG_UNKNOWN;
+    usd->side[ii] = 1;
   }
   return usd;
   
- fail_props:
-  heap_destroy (usd->queue_negative);
+ fail_pn:
+  dheap_destroy (usd->propagators_positive);
+ fail_pp:
+  dheap_destroy (usd->queue_negative);
  fail_qn:
-  heap_destroy (usd->queue_positive);
+  dheap_destroy (usd->queue_positive);
  fail_qp:
+  free (usd->side);
+ fail_side:
   free (usd->flags);
  fail_flags:
   free (usd->dist);
@@ -108,43 +142,42 @@ usdtrans_t * usdtrans_create (size_t dimx, size_t dimy)
 
 void usdtrans_destroy (usdtrans_t * usd)
 {
-  heap_destroy (usd->propagators);
-  heap_destroy (usd->queue_negative);
-  heap_destroy (usd->queue_positive);
+  dheap_destroy (usd->propagators_negative);
+  dheap_destroy (usd->propagators_positive);
+  dheap_destroy (usd->queue_negative);
+  dheap_destroy (usd->queue_positive);
+  free (usd->side);
   free (usd->flags);
   free (usd->dist);
   free (usd);
 }
 
 
-void usdtrans_requeue (usdtrans_t * usd, size_t index, double new_dist)
+void usdtrans_requeue_positive (usdtrans_t * usd, size_t index, double new_dist)
 {
-  if (usd->flags[index] & USDTRANS_FLAG_QUEUE_POSITIVE) {
-    heap_change_key (usd->queue_positive, usd->dist[index], new_dist, (void*) index);
-  }
-  else {
-    usd->flags[index] &= ~USDTRANS_FLAG_UNKNOWN;
-    usd->flags[index] |= USDTRANS_FLAG_QUEUE_POSITIVE;
-    heap_insert (usd->queue_positive, new_dist, (void*) index);
-  }
-  
-  if (usd->flags[index] & USDTRANS_FLAG_QUEUE_NEGATIVE) {
-    heap_change_key (usd->queue_negative, usd->dist[index], new_dist, (void*) index);
-  }
-  else {
-    usd->flags[index] &= ~USDTRANS_FLAG_UNKNOWN;
-    usd->flags[index] |= USDTRANS_FLAG_QUEUE_NEGATIVE;
-    heap_insert (usd->queue_negative, new_dist, (void*) index);
-  }
-  
+  usd->flags[index] &= ~USDTRANS_FLAG_UNKNOWN;
+  usd->flags[index] |= USDTRANS_FLAG_QUEUE_POSITIVE;
+  minq_set (usd->queue_positive, index, new_dist);
+  usd->dist[index] = new_dist;
+}
+
+
+void usdtrans_requeue_negative (usdtrans_t * usd, size_t index, double new_dist)
+{
+  usd->flags[index] &= ~USDTRANS_FLAG_UNKNOWN;
+  usd->flags[index] |= USDTRANS_FLAG_QUEUE_NEGATIVE;
+  maxq_set (usd->queue_negative, index, new_dist);
   usd->dist[index] = new_dist;
 }
 
 
 void usdtrans_seed (usdtrans_t * usd, size_t index, double dist)
 {
+  /* seeds propagate into both sides */
   usd->flags[index] |= USDTRANS_FLAG_FIXED;
-  usdtrans_requeue (usd, index, dist);
+  usd->side[index] = 0;
+  usdtrans_requeue_positive (usd, index, dist);
+  usdtrans_requeue_negative (usd, index, dist);
 }
 
 
@@ -165,6 +198,7 @@ void usdtrans_partition (usdtrans_t * usd, size_t index, double dist)
 {
   usd->dist[index] = dist;
   usd->flags[index] = USDTRANS_FLAG_UNKNOWN;
+  usd->side[index] = (dist < 0.0) ? -1 : 1;
 }
 
 
@@ -211,62 +245,63 @@ int usdtrans_fget2 (usdtrans_t * usd, size_t ix, size_t iy)
 
 void usdtrans_update_positive (usdtrans_t * usd, size_t index)
 {
+  dheap_t * const propagators = usd->propagators_positive;
   size_t nbor, ix, primary_index;
   int northsouth;
   double primary_dist, p2, rhs;
   
-  if (usd->flags[index] & USDTRANS_FLAG_FIXED) {
-    return;
+  if (usd->side[index] != 1) {
+    return;			/* seed, or other side of the partition */
   }
   
-  usd->propagators->length = 0;
+  propagators->length = 0;
   if (index >= usd->dimx) {
     nbor = index - usd->dimx;	/* try south */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] >= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, usd->dist[nbor], nbor);
     }
   }
   if (index < usd->toprow) {
     nbor = index + usd->dimx;	/* try north */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] >= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, usd->dist[nbor], nbor);
     }
   }
   ix = index % usd->dimx;
   if (ix > 0) {
     nbor = index - 1;		/* try west */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] >= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, usd->dist[nbor], nbor);
     }
   }
   if (ix < usd->rightcol) {
     nbor = index + 1;		/* try east */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] >= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, usd->dist[nbor], nbor);
     }
   }
   
-  if (0 == usd->propagators->length) {
+  if (0 == propagators->length) {
     return;			/* "never happens" though */
   }
   
-  primary_dist = usd->propagators->key[1];
+  primary_dist = DHEAP_PEEK_KEY (propagators);
   p2 = pow (primary_dist, 2.0);
-  primary_index = (size_t) usd->propagators->value[1];
+  primary_index = DHEAP_PEEK_HANDLE (propagators);
   northsouth = (ix == (primary_index % usd->dimx));
-  heap_pop (usd->propagators);
+  minq_pop (propagators);
   
-  for (/**/; 0 != usd->propagators->length; heap_pop (usd->propagators)) {
-    const size_t secondary_index = (size_t) usd->propagators->value[1];
+  for (/**/; 0 != propagators->length; minq_pop (propagators)) {
+    const size_t secondary_index = DHEAP_PEEK_HANDLE (propagators);
     if (northsouth ^ (ix == (secondary_index % usd->dimx))) {
-      const double secondary_dist = usd->propagators->key[1];
+      const double secondary_dist = DHEAP_PEEK_KEY (propagators);
       if (1.0 > secondary_dist - primary_dist) {
 	const double bb = primary_dist + secondary_dist;
 	const double cc = (p2 + pow (secondary_dist, 2.0) - 1.0) / 2.0;
 	const double root = pow (bb, 2.0) - 4.0 * cc;
 	rhs = (bb + sqrt (root)) / 2.0;
 	if (rhs < usd->dist[index]) {
-	  usdtrans_requeue (usd, index, rhs);
+	  usdtrans_requeue_positive (usd, index, rhs);
 	  return;
 	}
       }
@@ -275,69 +310,70 @@ void usdtrans_update_positive (usdtrans_t * usd, size_t index)
   
   rhs = primary_dist + 1.0;
   if (rhs < usd->dist[index]) {
-    usdtrans_requeue (usd, index, rhs);
+    usdtrans_requeue_positive (usd, index, rhs);
   }
 }
 
 
 void usdtrans_update_negative (usdtrans_t * usd, size_t index)
 {
+  dheap_t * const propagators = usd->propagators_negative;
   size_t nbor, ix, primary_index;
   int northsouth;
   double primary_dist, p2, rhs;
   
-  if (usd->flags[index] & USDTRANS_FLAG_FIXED) {
-    return;
+  if (usd->side[index] != -1) {
+    return;			/* seed, or other side of the partition */
   }
   
-  usd->propagators->length = 0;
+  propagators->length = 0;
   if (index >= usd->dimx) {
     nbor = index - usd->dimx;	/* try south */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, - usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] <= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, - usd->dist[nbor], nbor);
     }
   }
   if (index < usd->toprow) {
     nbor = index + usd->dimx;	/* try north */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, - usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] <= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, - usd->dist[nbor], nbor);
     }
   }
   ix = index % usd->dimx;
   if (ix > 0) {
     nbor = index - 1;		/* try west */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, - usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] <= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, - usd->dist[nbor], nbor);
     }
   }
   if (ix < usd->rightcol) {
     nbor = index + 1;		/* try east */
-    if ( ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
-      heap_insert (usd->propagators, - usd->dist[nbor], (void*) nbor);
+    if ((usd->side[nbor] <= 0) && ! (usd->flags[nbor] & USDTRANS_FLAG_UNKNOWN)) {
+      minq_insert (propagators, - usd->dist[nbor], nbor);
     }
   }
   
-  if (0 == usd->propagators->length) {
+  if (0 == propagators->length) {
     return;			/* "never happens" though */
   }
   
-  primary_dist = usd->propagators->key[1];
+  primary_dist = DHEAP_PEEK_KEY (propagators);
   p2 = pow (primary_dist, 2.0);
-  primary_index = (size_t) usd->propagators->value[1];
+  primary_index = DHEAP_PEEK_HANDLE (propagators);
   northsouth = (ix == (primary_index % usd->dimx));
-  heap_pop (usd->propagators);
+  minq_pop (propagators);
   
-  for (/**/; 0 != usd->propagators->length; heap_pop (usd->propagators)) {
-    const size_t secondary_index = (size_t) usd->propagators->value[1];
+  for (/**/; 0 != propagators->length; minq_pop (propagators)) {
+    const size_t secondary_index = DHEAP_PEEK_HANDLE (propagators);
     if (northsouth ^ (ix == (secondary_index % usd->dimx))) {
-      const double secondary_dist = usd->propagators->key[1];
+      const double secondary_dist = DHEAP_PEEK_KEY (propagators);
       if (1.0 > secondary_dist - primary_dist) {
 	const double bb = primary_dist + secondary_dist;
 	const double cc = (p2 + pow (secondary_dist, 2.0) - 1.0) / 2.0;
 	const double root = pow (bb, 2.0) - 4.0 * cc;
 	rhs = - (bb + sqrt (root)) / 2.0;
 	if (rhs > usd->dist[index]) {
-	  usdtrans_requeue (usd, index, rhs);
+	  usdtrans_requeue_negative (usd, index, rhs);
 	  return;
 	}
       }
@@ -346,7 +382,7 @@ void usdtrans_update_negative (usdtrans_t * usd, size_t index)
   
   rhs = - primary_dist - 1.0;
   if (rhs > usd->dist[index]) {
-    usdtrans_requeue (usd, index, rhs);
+    usdtrans_requeue_negative (usd, index, rhs);
   }
 }
 
@@ -354,7 +390,7 @@ void usdtrans_update_negative (usdtrans_t * usd, size_t index)
 void usdtrans_propagate_positive (usdtrans_t * usd)
 {
   size_t index, ix;
-  index = (size_t) heap_pop (usd->queue_positive);
+  index = minq_pop (usd->queue_positive);
   if (index >= usd->dimx) {
     usdtrans_update_positive (usd, index - usd->dimx); /* south */
   }
@@ -374,7 +410,7 @@ void usdtrans_propagate_positive (usdtrans_t * usd)
 void usdtrans_propagate_negative (usdtrans_t * usd)
 {
   size_t index, ix;
-  index = (size_t) heap_pop (usd->queue_negative);
+  index = maxq_pop (usd->queue_negative);
   if (index >= usd->dimx) {
     usdtrans_update_negative (usd, index - usd->dimx); /* south */
   }
@@ -394,7 +430,7 @@ void usdtrans_propagate_negative (usdtrans_t * usd)
 void usdtrans_compute_positive (usdtrans_t * usd, double maxdist)
 {
   while (0 != usd->queue_positive->length) {
-    if (usd->queue_positive->key[1] > maxdist) {
+    if (DHEAP_PEEK_KEY (usd->queue_positive) > maxdist) {
       break;
     }
     usdtrans_propagate_positive (usd);
@@ -405,7 +441,7 @@ void usdtrans_compute_positive (usdtrans_t * usd, double maxdist)
 void usdtrans_compute_negative (usdtrans_t * usd, double mindist)
 {
   while (0 != usd->queue_negative->length) {
-    if (usd->queue_negative->key[1] < mindist) {
+    if (DHEAP_PEEK_KEY (usd->queue_negative) < mindist) {
       break;
     }
     usdtrans_propagate_negative (usd);
@@ -420,6 +456,46 @@ void usdtrans_compute (usdtrans_t * usd, double range)
 }
 
 
+typedef struct usdtrans_job_s {
+  usdtrans_t * usd;
+  double range;
+} usdtrans_job_t;
+
+
+static void * usdtrans_positive_thread (void * arg)
+{
+  usdtrans_job_t * job = arg;
+  usdtrans_compute_positive (job->usd, job->range);
+  return NULL;
+}
+
+
+/*
+  Same result as usdtrans_compute, but the positive side runs in a
+  second thread while the calling thread does the negative side. The
+  two sides have their own queues, propagator scratch heaps, and
+  cells, and share only the seeds, which are read-only by now (see
+  the side field of usdtrans_t). Falls back to usdtrans_compute if
+  the thread cannot be created.
+  
+  Returns 0 if both sides ran concurrently, -1 if it fell back.
+*/
+int usdtrans_compute_concurrent (usdtrans_t * usd, double range)
+{
+  pthread_t thread;
+  usdtrans_job_t job;
+  job.usd = usd;
+  job.range = range;
+  if (0 != pthread_create (&thread, NULL, usdtrans_positive_thread, &job)) {
+    usdtrans_compute (usd, range);
+    return -1;
+  }
+  usdtrans_compute_negative (usd, -range);
+  pthread_join (thread, NULL);
+  return 0;
+}
+
+
 static void pnum6 (FILE * fp, double num)
 {
   if (isinf(num)) {
@@ -449,10 +525,92 @@ static void dump (usdtrans_t * usd)
 }
 
 
+static double now (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6 * tv.tv_usec;
+}
+
+
+/*
+  Partition a dim x dim grid into the inside (negative) and outside
+  (positive) of a centered circle, and seed the cells on both sides
+  of its boundary with their exact signed distance.
+*/
+static usdtrans_t * circle (size_t dim)
+{
+  usdtrans_t * usd;
+  size_t ix, iy;
+  double const cc = 0.5 * (dim - 1);
+  double const rr = dim / 3.0;
+  if ( ! (usd = usdtrans_create (dim, dim))) {
+    err (EXIT_FAILURE, "failed to create usd\n");
+  }
+  for (ix = 0; ix < dim; ++ix) {
+    for (iy = 0; iy < dim; ++iy) {
+      double const dd = sqrt (pow (ix - cc, 2.0) + pow (iy - cc, 2.0)) - rr;
+      if (fabs (dd) < 1.0) {
+	usdtrans_seed2 (usd, ix, iy, dd);
+      }
+      else {
+	usdtrans_partition2 (usd, ix, iy, (dd < 0.0) ? -USDTRANS_INFINITY : USDTRANS_INFINITY);
+      }
+    }
+  }
+  return usd;
+}
+
+
+static void bench (size_t dim)
+{
+  usdtrans_t * serial;
+  usdtrans_t * concurrent;
+  double t0, t_serial, t_concurrent, maxerr;
+  size_t ii;
+  
+  serial = circle (dim);
+  t0 = now ();
+  usdtrans_compute (serial, USDTRANS_INFINITY);
+  t_serial = now () - t0;
+  
+  concurrent = circle (dim);
+  t0 = now ();
+  if (0 != usdtrans_compute_concurrent (concurrent, USDTRANS_INFINITY)) {
+    warnx ("failed to start thread, fell back to serial computation");
+  }
+  t_concurrent = now () - t0;
+  
+  maxerr = 0.0;
+  for (ii = 0; ii < serial->ncells; ++ii) {
+    double const ee = fabs (serial->dist[ii] - concurrent->dist[ii]);
+    if (ee > maxerr) {
+      maxerr = ee;
+    }
+  }
+  
+  printf ("%zux%zu  serial %.3f s  concurrent %.3f s  speedup %.2f  maxerr %g\n",
+	  dim, dim, t_serial, t_concurrent, t_serial / t_concurrent, maxerr);
+  
+  usdtrans_destroy (concurrent);
+  usdtrans_destroy (serial);
+}
+
+
 int main (int argc, char ** argv)
 {
   usdtrans_t * usd;
   size_t ix, iy;
+  
+  if (argc > 1) {
+    int const dim = atoi (argv[1]);
+    if (dim < 3) {
+      errx (EXIT_FAILURE, "usage: %s [dim]  (dim must be at least 3)", argv[0]);
+    }
+    bench (dim);
+    return 0;
+  }
+  
   if ( ! (usd = usdtrans_create (5, 10))) {
     err (EXIT_FAILURE, "failed to create usd\n");
   }
@@ -468,6 +626,9 @@ int main (int argc, char ** argv)
     }
   }
   dump (usd);
+  fprintf (stdout, "\n");
+  usdtrans_compute_concurrent (usd, 100.0);
+  dump (usd);
   usdtrans_destroy (usd);
   return 0;
 }